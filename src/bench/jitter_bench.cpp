@@ -0,0 +1,211 @@
+#include "jitter_bench.h"
+
+#include "../driver/test_driver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <numeric>
+#include <sys/mman.h>
+
+namespace {
+
+constexpr int bench_priority = 80;
+constexpr size_t memory_load_bytes = 32 * 1024 * 1024;
+
+// a write that never shows up means the loop thread is gone
+constexpr std::chrono::seconds write_timeout(1);
+
+} // namespace
+
+Result<> JitterBench::run() {
+    unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    Realtime::Params realtime;
+    realtime.m_enabled = true;
+    realtime.m_priority = bench_priority;
+    realtime.m_cpu = static_cast<int>(cpus) - 1;
+    realtime.m_lock_memory = true;
+
+    Result<> idle_res = measure("idle", Realtime::Params());
+    if (!idle_res.is_ok()) {
+        return Result<>::Err(Error(__func__, idle_res));
+    }
+
+    start_load();
+
+    Result<> load_res = measure("load", Realtime::Params());
+    if (!load_res.is_ok()) {
+        stop_load();
+        return Result<>::Err(Error(__func__, load_res));
+    }
+
+    // last, there is no undoing mlockall
+    Realtime::lock_memory(m_logger);
+
+    Result<> rt_res = measure("load + realtime", realtime);
+
+    stop_load();
+
+    if (!rt_res.is_ok()) {
+        return Result<>::Err(Error(__func__, rt_res));
+    }
+
+    return Result<>::Ok(None{});
+}
+
+Result<> JitterBench::measure(const std::string& label,
+                              const Realtime::Params& realtime) {
+    std::shared_ptr<TestDriver> driver = TestDriver::create();
+    if (!driver->init()) {
+        return Result<>::Err(Error(__func__, "failed to start test driver"));
+    }
+
+    Plug::Config config;
+    config.m_model_str = "PLUG_V1";
+    config.m_gpio_pin = 0;
+    config.m_lock_duration = 0;
+    config.m_device_id = "jitter";
+    config.m_gateway_url = "";
+    config.m_gateway_namespace = "";
+    config.m_reconn_delay = 0;
+    config.m_reconn_attempts = 0;
+
+    // never started, only needed to construct the plug
+    Plug::Services services;
+    services.m_driver = driver;
+    services.m_scheduler = std::make_shared<Scheduler>(std::nullopt);
+    services.m_realtime = realtime;
+
+    Plug plug(config);
+    if (!plug.init_offline(services)) {
+        driver->shutdown();
+        return Result<>::Err(Error(__func__, "failed to start plug"));
+    }
+
+    std::vector<uint64_t> latencies_ns;
+    latencies_ns.reserve(m_iterations);
+
+    // delivered like the client does, built once outside the timed path
+    std::map<std::string, ::sio::message::ptr> power_on = {
+        {"command", ::sio::string_message::create("power_on")}};
+    std::map<std::string, ::sio::message::ptr> power_off = {
+        {"command", ::sio::string_message::create("power_off")}};
+
+    bool timed_out = false;
+    for (unsigned int i = 0; i < m_iterations; i++) {
+        uint64_t writes = driver->get_write_count();
+
+        // alternate so every command is a real transition
+        std::map<std::string, ::sio::message::ptr>& data =
+            (i % 2 == 0) ? power_on : power_off;
+
+        auto t0 = std::chrono::steady_clock::now();
+        plug.on_command_received(data);
+
+        // the write time is taken on the loop thread, polling here does
+        // not add to the measured delay
+        while (driver->get_write_count() == writes) {
+            if (std::chrono::steady_clock::now() - t0 > write_timeout) {
+                timed_out = true;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        if (timed_out) {
+            break;
+        }
+
+        latencies_ns.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                driver->get_last_write_time() - t0)
+                .count());
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_period_ms));
+    }
+
+    plug.shutdown();
+    driver->shutdown();
+
+    if (timed_out) {
+        return Result<>::Err(Error(__func__, "relay write timed out"));
+    }
+
+    report(label, latencies_ns);
+
+    return Result<>::Ok(None{});
+}
+
+void JitterBench::report(const std::string& label,
+                         std::vector<uint64_t>& latencies_ns) {
+    if (latencies_ns.empty()) {
+        return;
+    }
+
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+
+    auto percentile = [&](double p) {
+        size_t idx = static_cast<size_t>(p * (latencies_ns.size() - 1));
+        return std::to_string(latencies_ns[idx] / 1000.0);
+    };
+
+    double mean_ns =
+        std::accumulate(latencies_ns.begin(), latencies_ns.end(), 0.0) /
+        latencies_ns.size();
+
+    m_logger.log(label + ": " + std::to_string(latencies_ns.size()) +
+                 " switches, latency (us): min " + percentile(0.0) +
+                 ", mean " + std::to_string(mean_ns / 1000.0) + ", p50 " +
+                 percentile(0.5) + ", p99 " + percentile(0.99) + ", max " +
+                 percentile(1.0));
+}
+
+void JitterBench::start_load() {
+    unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    m_load_running = true;
+    for (unsigned int i = 0; i < cpus; i++) {
+        m_load_threads.emplace_back(&JitterBench::cpu_load, this);
+    }
+    m_load_threads.emplace_back(&JitterBench::memory_load, this);
+
+    m_logger.log("Started load on " + std::to_string(cpus) + " CPU(s)");
+}
+
+void JitterBench::stop_load() {
+    m_load_running = false;
+    for (std::thread& t : m_load_threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    m_load_threads.clear();
+}
+
+void JitterBench::cpu_load() {
+    volatile uint64_t x = 0;
+    while (m_load_running) {
+        for (int i = 0; i < 100000; i++) {
+            x = x + i;
+        }
+    }
+}
+
+void JitterBench::memory_load() {
+    // fresh pages every round, touched so they are really faulted in. mapped
+    // directly so malloc settings from lock_memory do not turn it into a
+    // reuse of already resident heap in the last case
+    while (m_load_running) {
+        void* buf = mmap(nullptr, memory_load_bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        std::memset(buf, 0xa5, memory_load_bytes);
+        munmap(buf, memory_load_bytes);
+    }
+}
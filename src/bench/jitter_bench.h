@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../plug.h"
+#include "../realtime.h"
+
+#include <homecontroller/util/logger.h>
+#include <homecontroller/util/result.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Measures the delay from a delivered command to the relay write on the
+// plug loop thread, idle and under synthetic CPU and memory load, with and
+// without real-time scheduling.
+class JitterBench {
+  public:
+    JitterBench(unsigned int iterations, unsigned int period_ms)
+        : m_logger("JitterBench"), m_iterations(iterations),
+          m_period_ms(period_ms), m_load_running(false) {}
+    ~JitterBench() {}
+
+    Result<> run();
+
+  private:
+    Result<> measure(const std::string& label,
+                     const Realtime::Params& realtime);
+    void report(const std::string& label, std::vector<uint64_t>& latencies_ns);
+
+    void start_load();
+    void stop_load();
+    void cpu_load();
+    void memory_load();
+
+    hc::util::Logger m_logger;
+
+    unsigned int m_iterations;
+    unsigned int m_period_ms;
+
+    std::atomic<bool> m_load_running;
+    std::vector<std::thread> m_load_threads;
+};
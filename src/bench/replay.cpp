@@ -0,0 +1,237 @@
+#include "replay.h"
+
+#include "../capture/message.h"
+#include "../capture/reader.h"
+#include "../driver/test_driver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+// covers the relay lock window of the last command
+constexpr std::chrono::seconds drain_timeout(30);
+
+// submit to applied and published, taken on the plug loop threads
+class LatencyObserver : public Plug::Observer {
+  public:
+    void on_applied(const std::string& device_id,
+                    std::chrono::steady_clock::duration latency) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latencies_ns.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(latency)
+                .count());
+    }
+
+    // once the loop threads are stopped
+    std::vector<uint64_t>& get_latencies_ns() { return m_latencies_ns; }
+
+  private:
+    std::mutex m_mutex;
+    std::vector<uint64_t> m_latencies_ns;
+};
+
+} // namespace
+
+Result<Replay::Mode> Replay::str_to_mode(const std::string& str) {
+    static std::map<std::string, Mode> str_to_mode_map = {
+        {"fast", Mode::FAST}, {"timed", Mode::TIMED}};
+
+    auto mit = str_to_mode_map.find(str);
+    if (mit == str_to_mode_map.end()) {
+        return Result<Mode>::Err(Error(__func__, "invalid replay mode"));
+    }
+
+    return Result<Mode>::Ok(mit->second);
+}
+
+Result<> Replay::run(const std::vector<Plug::Config>& plug_configs) {
+    CaptureReader reader(m_path);
+    Result<> open_res = reader.open();
+    if (!open_res.is_ok()) {
+        return Result<>::Err(Error(__func__, open_res));
+    }
+
+    std::shared_ptr<TestDriver> driver = TestDriver::create();
+    if (!driver->init()) {
+        return Result<>::Err(Error(__func__, "failed to start test driver"));
+    }
+
+    // never started, schedules must not fire during a replay
+    Plug::Services services;
+    services.m_driver = driver;
+    services.m_scheduler = std::make_shared<Scheduler>(std::nullopt);
+
+    std::shared_ptr<LatencyObserver> observer =
+        std::make_shared<LatencyObserver>();
+    services.m_observer = observer;
+
+    std::map<std::string, std::unique_ptr<Plug>, std::less<>> plugs;
+
+    auto stop_all = [&]() {
+        for (auto& [device_id, plug] : plugs) {
+            plug->shutdown();
+        }
+
+        driver->shutdown();
+    };
+
+    for (Plug::Config pc : plug_configs) {
+        // the lock window and rate limit would dominate the measured
+        // latency of a compressed replay, and differ by config not build
+        if (m_mode == Mode::FAST) {
+            pc.m_lock_duration = 0;
+            pc.m_rate_limit = 0.0;
+        }
+
+        std::unique_ptr<Plug> plug = std::make_unique<Plug>(pc);
+
+        if (!plug->init_offline(services)) {
+            stop_all();
+            return Result<>::Err(Error(__func__, "failed to start plug"));
+        }
+
+        plugs[pc.m_device_id] = std::move(plug);
+    }
+
+    m_logger.log("Replaying \"" + m_path + "\" (" +
+                 (m_mode == Mode::FAST ? "fast, unthrottled" : "timed") +
+                 ")");
+
+    uint64_t replayed = 0;
+    uint64_t skipped = 0;
+    uint64_t malformed = 0;
+    uint64_t recorded_states = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    Result<> fe_res =
+        reader.for_each([&](const CaptureReader::Record& record) {
+            if (record.m_type == capture::RecordType::STATE) {
+                recorded_states++;
+                return;
+            }
+
+            if (record.m_type != capture::RecordType::COMMAND &&
+                record.m_type != capture::RecordType::FRAME) {
+                return;
+            }
+
+            auto pit = plugs.find(record.m_device_id);
+            if (pit == plugs.end()) {
+                skipped++;
+                return;
+            }
+
+            // rebuilt as the client delivered it
+            std::map<std::string, ::sio::message::ptr> data;
+            if (record.m_type == capture::RecordType::FRAME) {
+                data["frame"] = ::sio::binary_message::create(
+                    std::make_shared<const std::string>(record.m_payload));
+            } else {
+                Result<std::map<std::string, ::sio::message::ptr>> data_res =
+                    capture::decode_message(record.m_payload);
+                if (!data_res.is_ok()) {
+                    malformed++;
+                    return;
+                }
+
+                data = data_res.unwrap();
+            }
+
+            if (m_mode == Mode::TIMED) {
+                std::this_thread::sleep_until(
+                    start + std::chrono::nanoseconds(record.m_timestamp_ns));
+            }
+
+            pit->second->on_command_received(data);
+            replayed++;
+        });
+
+    // every command is applied, coalesced or dropped once the plugs drain
+    auto drained = [&]() {
+        for (const auto& [device_id, plug] : plugs) {
+            Plug::Stats stats = plug->get_stats();
+            if (stats.m_applied + stats.m_coalesced + stats.m_dropped <
+                stats.m_received) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    auto drain_start = std::chrono::steady_clock::now();
+    while (!drained()) {
+        if (std::chrono::steady_clock::now() - drain_start > drain_timeout) {
+            m_logger.warn("Plugs did not drain, latencies are incomplete");
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    uint64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+
+    stop_all();
+
+    for (const auto& [device_id, plug] : plugs) {
+        Plug::Stats stats = plug->get_stats();
+        m_logger.log(device_id + ": received " +
+                     std::to_string(stats.m_received) + ", applied " +
+                     std::to_string(stats.m_applied) + ", coalesced " +
+                     std::to_string(stats.m_coalesced) + ", dropped " +
+                     std::to_string(stats.m_dropped));
+    }
+
+    if (!fe_res.is_ok()) {
+        m_logger.warn("Capture ended early: " + fe_res.unwrap_err());
+    }
+
+    // the loop threads are stopped, no more samples arrive
+    report(replayed, observer->get_latencies_ns(), elapsed_ns, skipped,
+           malformed, recorded_states);
+
+    return Result<>::Ok(None{});
+}
+
+void Replay::report(uint64_t replayed, std::vector<uint64_t>& latencies_ns,
+                    uint64_t elapsed_ns, uint64_t skipped,
+                    uint64_t malformed, uint64_t recorded_states) {
+    m_logger.log("Commands replayed: " + std::to_string(replayed) +
+                 ", skipped (unknown device): " + std::to_string(skipped) +
+                 ", skipped (malformed): " + std::to_string(malformed) +
+                 ", recorded states: " + std::to_string(recorded_states));
+
+    double elapsed_s = elapsed_ns / 1e9;
+    m_logger.log("Elapsed: " + std::to_string(elapsed_s) + " s, throughput: " +
+                 std::to_string(replayed / elapsed_s) + " cmd/s");
+
+    // coalesced and no-op commands never switch the relay
+    if (latencies_ns.empty()) {
+        return;
+    }
+
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+
+    auto percentile = [&](double p) {
+        size_t idx = static_cast<size_t>(p * (latencies_ns.size() - 1));
+        return std::to_string(latencies_ns[idx] / 1000.0);
+    };
+
+    double mean_ns =
+        std::accumulate(latencies_ns.begin(), latencies_ns.end(), 0.0) /
+        latencies_ns.size();
+
+    m_logger.log("Submit to switch published, " +
+                 std::to_string(latencies_ns.size()) +
+                 " switch(es), latency (us): min " + percentile(0.0) +
+                 ", mean " +
+                 std::to_string(mean_ns / 1000.0) + ", p50 " +
+                 percentile(0.5) + ", p99 " + percentile(0.99) + ", max " +
+                 percentile(1.0));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../plug.h"
+
+#include <homecontroller/util/logger.h>
+#include <homecontroller/util/result.h>
+
+// Feeds a capture file back through the command handlers of offline plugs on
+// the test driver and reports throughput and the latency from submitting a
+// command to its relay switch being published. FAST replays as quickly as
+// possible with lock_duration and rate_limit off, so builds can be compared.
+// TIMED keeps the capture's pacing and the configured throttling.
+class Replay {
+  public:
+    enum class Mode { FAST, TIMED };
+
+    static Result<Mode> str_to_mode(const std::string& str);
+
+    Replay(const std::string& path, Mode mode)
+        : m_logger("Replay"), m_path(path), m_mode(mode) {}
+    ~Replay() {}
+
+    Result<> run(const std::vector<Plug::Config>& plug_configs);
+
+  private:
+    void report(uint64_t replayed, std::vector<uint64_t>& latencies_ns,
+                uint64_t elapsed_ns, uint64_t skipped, uint64_t malformed,
+                uint64_t recorded_states);
+
+    hc::util::Logger m_logger;
+
+    std::string m_path;
+    Mode m_mode;
+};
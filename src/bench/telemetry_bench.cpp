@@ -0,0 +1,96 @@
+#include "telemetry_bench.h"
+
+#include "../driver/test_driver.h"
+#include "../telemetry/power_meter.h"
+#include "../telemetry/ring_buffer.h"
+
+#include <chrono>
+#include <vector>
+
+Result<> TelemetryBench::run() {
+    std::shared_ptr<TestDriver> driver = TestDriver::create();
+    if (!driver->init()) {
+        return Result<>::Err(Error(__func__, "failed to start test driver"));
+    }
+
+    Driver::AdcParams adc_params;
+    adc_params.m_channels = m_channels;
+    adc_params.m_spi_channel = 0;
+    adc_params.m_spi_baud = 0;
+    adc_params.m_sample_rate = m_sample_rate;
+
+    if (!driver->open_adc(adc_params)) {
+        driver->shutdown();
+        return Result<>::Err(Error(__func__, "failed to open synthetic ADC"));
+    }
+
+    PowerMeter::Params meter_params;
+    meter_params.m_channels = m_channels;
+    meter_params.m_sample_rate = m_sample_rate;
+    meter_params.m_window_ms = 200;
+    meter_params.m_voltage = 120.0;
+    meter_params.m_amps_per_count = 0.0264;
+
+    PowerMeter meter(meter_params);
+    RingBuffer<uint16_t> ring(meter.get_window_samples() * m_channels);
+
+    std::vector<uint16_t> frame(m_channels);
+    std::vector<uint16_t> block(meter.get_window_samples() * m_channels);
+
+    uint64_t frames = static_cast<uint64_t>(m_sample_rate) * m_seconds;
+
+    std::chrono::nanoseconds read_ns(0);
+    std::chrono::nanoseconds aggregate_ns(0);
+
+    for (uint64_t i = 0; i < frames;) {
+        auto t0 = std::chrono::steady_clock::now();
+        while (i < frames) {
+            driver->read_adc(frame.data());
+            if (!ring.push(frame.data(), frame.size())) {
+                break;
+            }
+            i++;
+        }
+
+        auto t1 = std::chrono::steady_clock::now();
+        size_t count;
+        while ((count = ring.pop(block.data(), block.size())) > 0) {
+            meter.add_frames(block.data(), count / m_channels);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        read_ns += t1 - t0;
+        aggregate_ns += t2 - t1;
+    }
+
+    driver->close_adc();
+    driver->shutdown();
+
+    auto per_frame = [&](std::chrono::nanoseconds ns) {
+        return std::to_string(static_cast<double>(ns.count()) / frames);
+    };
+
+    double total_s = (read_ns + aggregate_ns).count() / 1e9;
+
+    m_logger.log(std::to_string(frames) + " frames x " +
+                 std::to_string(m_channels) + " channel(s), " +
+                 std::to_string(m_seconds) + " s of signal at " +
+                 std::to_string(m_sample_rate) + " Hz");
+    m_logger.log("Source + ring: " + per_frame(read_ns) + " ns/frame");
+    m_logger.log("Aggregation: " + per_frame(aggregate_ns) + " ns/frame");
+    m_logger.log("Throughput: " + std::to_string(frames / total_s) +
+                 " frames/s (" +
+                 std::to_string(frames / total_s / m_sample_rate) +
+                 "x real time)");
+
+    for (unsigned int c = 0; c < m_channels; c++) {
+        PowerMeter::Stats stats = meter.take_stats(c);
+        m_logger.log("Channel " + std::to_string(c) + ": mean " +
+                     std::to_string(stats.m_mean_w) + " W, min " +
+                     std::to_string(stats.m_min_w) + " W, max " +
+                     std::to_string(stats.m_max_w) + " W, " +
+                     std::to_string(stats.m_energy_kwh) + " kWh");
+    }
+
+    return Result<>::Ok(None{});
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <homecontroller/util/logger.h>
+#include <homecontroller/util/result.h>
+
+// Pushes synthetic test driver waveforms through the ring buffer and power
+// meter as fast as possible, without the sampling thread's pacing.
+class TelemetryBench {
+  public:
+    TelemetryBench(unsigned int channels, unsigned int sample_rate,
+                   unsigned int seconds)
+        : m_logger("TelemetryBench"), m_channels(channels),
+          m_sample_rate(sample_rate), m_seconds(seconds) {}
+    ~TelemetryBench() {}
+
+    Result<> run();
+
+  private:
+    hc::util::Logger m_logger;
+
+    unsigned int m_channels;
+    unsigned int m_sample_rate;
+    unsigned int m_seconds;
+};
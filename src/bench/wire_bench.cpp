@@ -0,0 +1,187 @@
+#include "wire_bench.h"
+
+#include "../wire/codec.h"
+
+#include <charconv>
+#include <chrono>
+#include <map>
+
+namespace {
+
+// socket.io event packets: text events carry the JSON inline, binary ones
+// replace the buffer with a placeholder and send it as an attachment
+// prefixed by one engine.io type byte
+const std::string text_event_prefix = "42[\"state\",";
+const std::string binary_event_prefix = "451-[\"state\",";
+const std::string placeholder = "{\"_placeholder\":true,\"num\":0}";
+constexpr size_t attachment_overhead = 1;
+
+size_t text_packet_size(size_t json_len) {
+    return text_event_prefix.size() + json_len + 1;
+}
+
+size_t binary_packet_size(size_t json_len, size_t binary_len) {
+    return binary_event_prefix.size() + json_len + 1 + attachment_overhead +
+           binary_len;
+}
+
+double elapsed_ns(std::chrono::steady_clock::time_point start,
+                  unsigned int iterations) {
+    return static_cast<double>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()) /
+           iterations;
+}
+
+} // namespace
+
+Result<> WireBench::run() {
+    if (m_iterations == 0) {
+        return Result<>::Err(Error(__func__, "no iterations"));
+    }
+
+    m_logger.log("Bytes are payload / socket.io packet, time per message");
+
+    bench_state(false);
+    bench_state(true);
+    bench_command();
+
+    return Result<>::Ok(None{});
+}
+
+void WireBench::bench_state(bool with_power) {
+    hc::api::plug::State state;
+    state.m_power_state = hc::api::plug::State::PowerState::ON_LOCKED;
+    state.m_lock_duration = 1000;
+
+    PowerMeter::Stats stats = {};
+    stats.m_min_w = 431.25;
+    stats.m_mean_w = 447.8125;
+    stats.m_max_w = 463.5;
+    stats.m_energy_kwh = 12.3456789;
+    stats.m_windows = 25;
+
+    const PowerMeter::Stats* power = with_power ? &stats : nullptr;
+
+    // the object encoding pays for the message tree and its serialization
+    size_t json_len = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < m_iterations; i++) {
+        json_len += to_json(wire::state_to_message(state, power)).size();
+    }
+    double json_ns = elapsed_ns(start, m_iterations);
+
+    size_t binary_len = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < m_iterations; i++) {
+        binary_len += wire::encode_state(state, power).size();
+    }
+    double binary_ns = elapsed_ns(start, m_iterations);
+
+    json_len /= m_iterations;
+    binary_len /= m_iterations;
+
+    report(with_power ? "State + power encode" : "State encode", json_len,
+           text_packet_size(json_len), json_ns, binary_len,
+           binary_packet_size(placeholder.size(), binary_len), binary_ns);
+}
+
+void WireBench::bench_command() {
+    // what the client hands to on_command_received for either encoding,
+    // rebuilt every iteration like a received message
+    const std::string command_json = "{\"command\":\"power_on\"}";
+    const std::string frame = wire::encode_command(wire::Opcode::POWER_ON);
+
+    uint64_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < m_iterations; i++) {
+        std::map<std::string, ::sio::message::ptr> data;
+        data["command"] = ::sio::string_message::create("power_on");
+
+        Result<hc::api::plug::Command> cmd_res =
+            hc::api::plug::string_to_command(data["command"]->get_string());
+        sink += static_cast<uint64_t>(cmd_res.unwrap());
+    }
+    double json_ns = elapsed_ns(start, m_iterations);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < m_iterations; i++) {
+        std::map<std::string, ::sio::message::ptr> data;
+        data["frame"] = ::sio::binary_message::create(
+            std::make_shared<const std::string>(frame));
+
+        const std::string& bytes = *data["frame"]->get_binary();
+        Result<wire::Frame> frame_res =
+            wire::parse_frame(bytes.data(), bytes.size());
+
+        switch (frame_res.unwrap().m_opcode) {
+        case wire::Opcode::POWER_ON:
+            sink += 1;
+            break;
+        default:
+            break;
+        }
+    }
+    double binary_ns = elapsed_ns(start, m_iterations);
+
+    std::string frame_json = "{\"frame\":" + placeholder + "}";
+
+    report("Command decode", command_json.size(),
+           text_packet_size(command_json.size()), json_ns, frame.size(),
+           binary_packet_size(frame_json.size(), frame.size()), binary_ns);
+
+    m_logger.debug("sink " + std::to_string(sink));
+}
+
+void WireBench::report(const std::string& label, size_t json_payload,
+                       size_t json_packet, double json_ns,
+                       size_t binary_payload, size_t binary_packet,
+                       double binary_ns) {
+    m_logger.log(label + ": json " + std::to_string(json_payload) + " / " +
+                 std::to_string(json_packet) + " B, " +
+                 std::to_string(json_ns) + " ns; binary " +
+                 std::to_string(binary_payload) + " / " +
+                 std::to_string(binary_packet) + " B, " +
+                 std::to_string(binary_ns) + " ns");
+}
+
+std::string WireBench::to_json(const ::sio::message::ptr& msg) {
+    switch (msg->get_flag()) {
+    case ::sio::message::flag_object: {
+        std::string res = "{";
+        for (const auto& [key, value] : msg->get_map()) {
+            if (res.size() > 1) {
+                res += ",";
+            }
+            res += "\"" + key + "\":" + to_json(value);
+        }
+        return res + "}";
+    }
+    case ::sio::message::flag_array: {
+        std::string res = "[";
+        for (const ::sio::message::ptr& value : msg->get_vector()) {
+            if (res.size() > 1) {
+                res += ",";
+            }
+            res += to_json(value);
+        }
+        return res + "]";
+    }
+    case ::sio::message::flag_string:
+        return "\"" + msg->get_string() + "\"";
+    case ::sio::message::flag_integer:
+        return std::to_string(msg->get_int());
+    case ::sio::message::flag_double: {
+        // shortest round-trip form, like rapidjson
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), msg->get_double());
+        return std::string(buf, res.ptr);
+    }
+    case ::sio::message::flag_boolean:
+        return msg->get_bool() ? "true" : "false";
+    default:
+        return "null";
+    }
+}
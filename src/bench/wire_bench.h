@@ -0,0 +1,35 @@
+#pragma once
+
+#include <homecontroller/util/logger.h>
+#include <homecontroller/util/result.h>
+
+#include <sio_client.h>
+
+#include <string>
+
+// Compares the string-keyed object encoding with the binary frames: bytes
+// per message, with and without socket.io packet framing, and the cost of
+// encoding states and decoding commands.
+class WireBench {
+  public:
+    WireBench(unsigned int iterations)
+        : m_logger("WireBench"), m_iterations(iterations) {}
+    ~WireBench() {}
+
+    Result<> run();
+
+  private:
+    void bench_state(bool with_power);
+    void bench_command();
+
+    void report(const std::string& label, size_t json_payload,
+                size_t json_packet, double json_ns, size_t binary_payload,
+                size_t binary_packet, double binary_ns);
+
+    // compact JSON as the socket.io client serializes it
+    static std::string to_json(const ::sio::message::ptr& msg);
+
+    hc::util::Logger m_logger;
+
+    unsigned int m_iterations;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of a capture file. All integers are little-endian, records
+// are padded to 8 bytes so every header is aligned when the file is mapped.
+//
+//   FileHeader
+//   RecordHeader | device id | payload | padding
+//   RecordHeader | device id | payload | padding
+//   ...
+namespace capture {
+
+constexpr char magic[8] = {'P', 'L', 'U', 'G', 'C', 'A', 'P', '\0'};
+constexpr uint32_t version = 2;
+constexpr uint32_t alignment = 8;
+
+enum class RecordType : uint8_t { COMMAND = 1, STATE = 2, FRAME = 3 };
+
+// tags of the serialized command message, see message.h
+enum class ValueTag : uint8_t {
+    INTEGER = 1,
+    DOUBLE = 2,
+    BOOLEAN = 3,
+    NUL = 4,
+    STRING = 5,
+    BINARY = 6,
+    ARRAY = 7,
+    OBJECT = 8
+};
+
+struct FileHeader {
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_reserved;
+    uint64_t m_start_unix_ns; // wall clock time of the first timestamp
+};
+
+struct RecordHeader {
+    uint32_t m_length; // bytes after this header, including padding
+    RecordType m_type;
+    uint8_t m_device_id_len;
+    uint16_t m_payload_len;
+    uint64_t m_timestamp_ns; // relative to FileHeader::m_start_unix_ns
+};
+
+// COMMAND payload is the serialized command object, FRAME payload a binary
+// command frame as received, STATE payload is this struct
+struct StatePayload {
+    uint8_t m_power_state;
+    uint8_t m_reserved[3];
+    int32_t m_lock_duration;
+};
+
+// headers are copied as host structs
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "capture files are little-endian");
+static_assert(sizeof(FileHeader) == 24, "unexpected FileHeader layout");
+static_assert(sizeof(RecordHeader) == 16, "unexpected RecordHeader layout");
+static_assert(sizeof(StatePayload) == 8, "unexpected StatePayload layout");
+
+inline uint32_t padded(uint32_t len) {
+    return (len + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace capture
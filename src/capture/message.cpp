@@ -0,0 +1,229 @@
+#include "message.h"
+
+#include <cstring>
+
+namespace capture {
+
+namespace {
+
+// deeper input is rejected rather than recursed into
+constexpr int max_depth = 32;
+
+template <typename T> void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void put_bytes(std::string& out, const std::string& bytes) {
+    put(out, static_cast<uint32_t>(bytes.size()));
+    out.append(bytes);
+}
+
+void put_value(std::string& out, const ::sio::message::ptr& msg);
+
+void put_object(std::string& out,
+                const std::map<std::string, ::sio::message::ptr>& map) {
+    put(out, ValueTag::OBJECT);
+    put(out, static_cast<uint32_t>(map.size()));
+    for (const auto& [key, value] : map) {
+        put_bytes(out, key);
+        put_value(out, value);
+    }
+}
+
+void put_value(std::string& out, const ::sio::message::ptr& msg) {
+    if (!msg) {
+        put(out, ValueTag::NUL);
+        return;
+    }
+
+    switch (msg->get_flag()) {
+    case ::sio::message::flag_integer:
+        put(out, ValueTag::INTEGER);
+        put(out, static_cast<int64_t>(msg->get_int()));
+        return;
+    case ::sio::message::flag_double:
+        put(out, ValueTag::DOUBLE);
+        put(out, msg->get_double());
+        return;
+    case ::sio::message::flag_boolean:
+        put(out, ValueTag::BOOLEAN);
+        put(out, static_cast<uint8_t>(msg->get_bool() ? 1 : 0));
+        return;
+    case ::sio::message::flag_string:
+        put(out, ValueTag::STRING);
+        put_bytes(out, msg->get_string());
+        return;
+    case ::sio::message::flag_binary: {
+        static const std::string empty;
+        const std::shared_ptr<const std::string>& binary = msg->get_binary();
+        put(out, ValueTag::BINARY);
+        put_bytes(out, binary ? *binary : empty);
+        return;
+    }
+    case ::sio::message::flag_array:
+        put(out, ValueTag::ARRAY);
+        put(out, static_cast<uint32_t>(msg->get_vector().size()));
+        for (const ::sio::message::ptr& item : msg->get_vector()) {
+            put_value(out, item);
+        }
+        return;
+    case ::sio::message::flag_object:
+        put_object(out, msg->get_map());
+        return;
+    default:
+        put(out, ValueTag::NUL);
+        return;
+    }
+}
+
+// reads from the front of the remaining input, false once it runs out
+class Cursor {
+  public:
+    Cursor(std::string_view bytes) : m_bytes(bytes) {}
+
+    template <typename T> bool get(T& value) {
+        if (m_bytes.size() < sizeof(T)) {
+            return false;
+        }
+
+        std::memcpy(&value, m_bytes.data(), sizeof(T));
+        m_bytes.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    bool get_bytes(std::string& bytes) {
+        uint32_t len;
+        if (!get(len) || m_bytes.size() < len) {
+            return false;
+        }
+
+        bytes.assign(m_bytes.data(), len);
+        m_bytes.remove_prefix(len);
+        return true;
+    }
+
+    bool empty() const { return m_bytes.empty(); }
+
+  private:
+    std::string_view m_bytes;
+};
+
+bool get_value(Cursor& in, int depth, ::sio::message::ptr& msg);
+
+bool get_object(Cursor& in, int depth,
+                std::map<std::string, ::sio::message::ptr>& map) {
+    uint32_t count;
+    if (!in.get(count)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        std::string key;
+        if (!in.get_bytes(key) || !get_value(in, depth + 1, map[key])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool get_value(Cursor& in, int depth, ::sio::message::ptr& msg) {
+    ValueTag tag;
+    if (depth > max_depth || !in.get(tag)) {
+        return false;
+    }
+
+    switch (tag) {
+    case ValueTag::INTEGER: {
+        int64_t value;
+        if (!in.get(value)) {
+            return false;
+        }
+        msg = ::sio::int_message::create(value);
+        return true;
+    }
+    case ValueTag::DOUBLE: {
+        double value;
+        if (!in.get(value)) {
+            return false;
+        }
+        msg = ::sio::double_message::create(value);
+        return true;
+    }
+    case ValueTag::BOOLEAN: {
+        uint8_t value;
+        if (!in.get(value)) {
+            return false;
+        }
+        msg = ::sio::bool_message::create(value != 0);
+        return true;
+    }
+    case ValueTag::NUL:
+        msg = ::sio::null_message::create();
+        return true;
+    case ValueTag::STRING: {
+        std::string value;
+        if (!in.get_bytes(value)) {
+            return false;
+        }
+        msg = ::sio::string_message::create(value);
+        return true;
+    }
+    case ValueTag::BINARY: {
+        std::string value;
+        if (!in.get_bytes(value)) {
+            return false;
+        }
+        msg = ::sio::binary_message::create(
+            std::make_shared<const std::string>(std::move(value)));
+        return true;
+    }
+    case ValueTag::ARRAY: {
+        uint32_t count;
+        if (!in.get(count)) {
+            return false;
+        }
+
+        msg = ::sio::array_message::create();
+        for (uint32_t i = 0; i < count; i++) {
+            ::sio::message::ptr item;
+            if (!get_value(in, depth + 1, item)) {
+                return false;
+            }
+            msg->get_vector().push_back(item);
+        }
+        return true;
+    }
+    case ValueTag::OBJECT:
+        msg = ::sio::object_message::create();
+        return get_object(in, depth, msg->get_map());
+    }
+
+    return false;
+}
+
+} // namespace
+
+std::string
+encode_message(const std::map<std::string, ::sio::message::ptr>& data) {
+    std::string out;
+    put_object(out, data);
+    return out;
+}
+
+Result<std::map<std::string, ::sio::message::ptr>>
+decode_message(std::string_view bytes) {
+    Cursor in(bytes);
+    std::map<std::string, ::sio::message::ptr> data;
+
+    ValueTag tag;
+    if (!in.get(tag) || tag != ValueTag::OBJECT ||
+        !get_object(in, 0, data) || !in.empty()) {
+        return Result<std::map<std::string, ::sio::message::ptr>>::Err(
+            Error(__func__, "malformed command message"));
+    }
+
+    return Result<std::map<std::string, ::sio::message::ptr>>::Ok(data);
+}
+
+} // namespace capture
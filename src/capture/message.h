@@ -0,0 +1,29 @@
+#pragma once
+
+#include "format.h"
+
+#include <homecontroller/util/result.h>
+
+#include <sio_client.h>
+
+#include <map>
+#include <string>
+#include <string_view>
+
+// Serializes the message object of an incoming command, so a capture keeps
+// its arguments and replays it as received. Every value is a tag followed by
+// its data:
+//
+//   INTEGER int64 | DOUBLE double | BOOLEAN uint8 | NUL
+//   STRING, BINARY uint32 length | bytes
+//   ARRAY uint32 count | values
+//   OBJECT uint32 count | (uint32 key length | key | value) ...
+namespace capture {
+
+std::string
+encode_message(const std::map<std::string, ::sio::message::ptr>& data);
+
+Result<std::map<std::string, ::sio::message::ptr>>
+decode_message(std::string_view bytes);
+
+} // namespace capture
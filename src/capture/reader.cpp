@@ -0,0 +1,98 @@
+#include "reader.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CaptureReader::~CaptureReader() {
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+Result<> CaptureReader::open() {
+    int fd = ::open(m_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return Result<>::Err(
+            Error(__func__, "failed to open file \"" + m_path + "\""));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(capture::FileHeader)) {
+        ::close(fd);
+        return Result<>::Err(
+            Error(__func__, "\"" + m_path + "\" is not a capture file"));
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        return Result<>::Err(
+            Error(__func__, "failed to map \"" + m_path + "\""));
+    }
+
+    // records are read once, front to back
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    m_data = static_cast<const char*>(data);
+    m_size = st.st_size;
+
+    const capture::FileHeader* header =
+        reinterpret_cast<const capture::FileHeader*>(m_data);
+    if (std::memcmp(header->m_magic, capture::magic, sizeof(capture::magic)) !=
+        0) {
+        return Result<>::Err(
+            Error(__func__, "\"" + m_path + "\" is not a capture file"));
+    }
+
+    if (header->m_version != capture::version) {
+        return Result<>::Err(
+            Error(__func__, "unsupported capture version " +
+                                std::to_string(header->m_version)));
+    }
+
+    return Result<>::Ok(None{});
+}
+
+Result<>
+CaptureReader::for_each(std::function<void(const Record&)> callback) const {
+    size_t offset = sizeof(capture::FileHeader);
+
+    while (offset + sizeof(capture::RecordHeader) <= m_size) {
+        const capture::RecordHeader* header =
+            reinterpret_cast<const capture::RecordHeader*>(m_data + offset);
+        offset += sizeof(capture::RecordHeader);
+
+        if (header->m_length > m_size - offset ||
+            static_cast<size_t>(header->m_device_id_len) +
+                    header->m_payload_len >
+                header->m_length) {
+            return Result<>::Err(Error(__func__, "truncated record at offset " +
+                                                     std::to_string(offset)));
+        }
+
+        Record record;
+        record.m_type = header->m_type;
+        record.m_timestamp_ns = header->m_timestamp_ns;
+        record.m_device_id =
+            std::string_view(m_data + offset, header->m_device_id_len);
+        record.m_payload =
+            std::string_view(m_data + offset + header->m_device_id_len,
+                             header->m_payload_len);
+
+        callback(record);
+
+        offset += header->m_length;
+    }
+
+    return Result<>::Ok(None{});
+}
+
+uint64_t CaptureReader::get_start_unix_ns() const {
+    return reinterpret_cast<const capture::FileHeader*>(m_data)
+        ->m_start_unix_ns;
+}
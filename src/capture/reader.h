@@ -0,0 +1,37 @@
+#pragma once
+
+#include "format.h"
+
+#include <homecontroller/util/result.h>
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Maps a capture file read-only, records are handed out without copying.
+class CaptureReader {
+  public:
+    struct Record {
+        capture::RecordType m_type;
+        uint64_t m_timestamp_ns;
+        std::string_view m_device_id;
+        std::string_view m_payload;
+    };
+
+    CaptureReader(const std::string& path)
+        : m_path(path), m_data(nullptr), m_size(0) {}
+    ~CaptureReader();
+
+    Result<> open();
+
+    // stops at the first truncated or malformed record
+    Result<> for_each(std::function<void(const Record&)> callback) const;
+
+    uint64_t get_start_unix_ns() const;
+
+  private:
+    std::string m_path;
+
+    const char* m_data;
+    size_t m_size;
+};
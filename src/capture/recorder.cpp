@@ -0,0 +1,186 @@
+#include "recorder.h"
+
+#include "../watchdog/heartbeat.h"
+
+#include <cstring>
+
+namespace {
+
+// flush early once this much is buffered
+constexpr size_t flush_threshold = 64 * 1024;
+
+// stop buffering if the disk cannot keep up
+constexpr size_t max_buffered = 4 * 1024 * 1024;
+
+constexpr auto flush_interval = std::chrono::milliseconds(200);
+
+} // namespace
+
+bool Recorder::start() {
+    m_file = std::fopen(m_path.c_str(), "wb");
+    if (!m_file) {
+        m_logger.error("start(): Failed to open \"" + m_path + "\"");
+        return false;
+    }
+
+    m_start = std::chrono::steady_clock::now();
+
+    capture::FileHeader header = {};
+    std::memcpy(header.m_magic, capture::magic, sizeof(header.m_magic));
+    header.m_version = capture::version;
+    header.m_start_unix_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    if (std::fwrite(&header, sizeof(header), 1, m_file) != 1) {
+        m_logger.error("start(): Failed to write header");
+        std::fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+
+    m_buffer.reserve(flush_threshold);
+    m_write_buffer.reserve(flush_threshold);
+
+    m_running = true;
+    m_thread = std::thread(&Recorder::loop, this);
+
+    m_logger.log("Recording to \"" + m_path + "\"");
+    return true;
+}
+
+void Recorder::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+
+        m_running = false;
+        m_cv.notify_all();
+    }
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    std::fclose(m_file);
+    m_file = nullptr;
+
+    if (m_dropped > 0) {
+        m_logger.warn("Dropped " + std::to_string(m_dropped) +
+                      " record(s), writer could not keep up");
+    }
+
+    if (m_oversized > 0) {
+        m_logger.warn("Dropped " + std::to_string(m_oversized) +
+                      " record(s) over " + std::to_string(UINT16_MAX) +
+                      " bytes");
+    }
+
+    m_logger.log("Recording stopped");
+}
+
+void Recorder::record_command(
+    const std::string& device_id,
+    const std::map<std::string, ::sio::message::ptr>& data) {
+    std::string payload = capture::encode_message(data);
+    append(capture::RecordType::COMMAND, device_id, payload.data(),
+           payload.size());
+}
+
+void Recorder::record_frame(const std::string& device_id,
+                            const std::string& frame) {
+    append(capture::RecordType::FRAME, device_id, frame.data(), frame.size());
+}
+
+void Recorder::record_state(const std::string& device_id,
+                            const hc::api::plug::State& state) {
+    capture::StatePayload payload = {};
+    payload.m_power_state = static_cast<uint8_t>(state.m_power_state);
+    payload.m_lock_duration = state.m_lock_duration;
+
+    append(capture::RecordType::STATE, device_id, &payload, sizeof(payload));
+}
+
+void Recorder::loop() {
+    Heartbeat heartbeat("recorder");
+    heartbeat.beat("acquire", "Recorder::m_mutex");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        heartbeat.beat("wait_flush", "Recorder::m_mutex");
+        heartbeat.wait_for(m_cv, lock, flush_interval, [&]() {
+            return !m_running || m_buffer.size() >= flush_threshold;
+        });
+
+        m_write_buffer.swap(m_buffer);
+        bool running = m_running;
+
+        // write without blocking callers
+        lock.unlock();
+        heartbeat.beat("write_file");
+        if (!m_write_buffer.empty()) {
+            if (std::fwrite(m_write_buffer.data(), 1, m_write_buffer.size(),
+                            m_file) != m_write_buffer.size()) {
+                m_logger.error("loop(): Write failed");
+            }
+            std::fflush(m_file);
+            m_write_buffer.clear();
+        }
+        heartbeat.beat("acquire", "Recorder::m_mutex");
+        lock.lock();
+
+        if (!running && m_buffer.empty()) {
+            return;
+        }
+    }
+}
+
+void Recorder::append(capture::RecordType type, const std::string& device_id,
+                      const void* payload, size_t payload_len) {
+    uint64_t timestamp_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start)
+            .count();
+
+    size_t device_id_len = std::min<size_t>(device_id.size(), UINT8_MAX);
+
+    capture::RecordHeader header = {};
+    header.m_type = type;
+    header.m_device_id_len = static_cast<uint8_t>(device_id_len);
+    header.m_payload_len = static_cast<uint16_t>(payload_len);
+    header.m_length = capture::padded(device_id_len + payload_len);
+    header.m_timestamp_ns = timestamp_ns;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_running) {
+        return;
+    }
+
+    // a truncated payload could not be replayed
+    if (payload_len > UINT16_MAX) {
+        m_oversized++;
+        return;
+    }
+
+    if (m_buffer.size() >= max_buffered) {
+        m_dropped++;
+        return;
+    }
+
+    size_t offset = m_buffer.size();
+    m_buffer.resize(offset + sizeof(header) + header.m_length, 0);
+
+    char* dst = m_buffer.data() + offset;
+    std::memcpy(dst, &header, sizeof(header));
+    std::memcpy(dst + sizeof(header), device_id.data(), device_id_len);
+    std::memcpy(dst + sizeof(header) + device_id_len, payload, payload_len);
+
+    if (m_buffer.size() >= flush_threshold) {
+        m_cv.notify_all();
+    }
+}
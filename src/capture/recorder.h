@@ -0,0 +1,59 @@
+#pragma once
+
+#include "format.h"
+#include "message.h"
+
+#include <homecontroller/api/device_data/plug.h>
+#include <homecontroller/util/logger.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Appends every incoming command, arguments included, and every outgoing
+// state to a capture file.
+// Callers only encode into a memory buffer, a writer thread flushes it to disk.
+class Recorder {
+  public:
+    Recorder(const std::string& path)
+        : m_logger("Recorder"), m_path(path), m_file(nullptr),
+          m_running(false), m_dropped(0), m_oversized(0) {}
+    ~Recorder() { shutdown(); }
+
+    bool start();
+    void shutdown();
+
+    void record_command(const std::string& device_id,
+                        const std::map<std::string, ::sio::message::ptr>& data);
+    void record_frame(const std::string& device_id, const std::string& frame);
+    void record_state(const std::string& device_id,
+                      const hc::api::plug::State& state);
+
+  private:
+    void loop();
+
+    void append(capture::RecordType type, const std::string& device_id,
+                const void* payload, size_t payload_len);
+
+    hc::util::Logger m_logger;
+
+    std::string m_path;
+    std::FILE* m_file;
+
+    std::chrono::steady_clock::time_point m_start;
+
+    // filled by callers, swapped with m_write_buffer by the writer thread
+    std::vector<char> m_buffer;
+    std::vector<char> m_write_buffer;
+
+    bool m_running;
+    uint64_t m_dropped;
+    uint64_t m_oversized;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
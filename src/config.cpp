@@ -2,21 +2,34 @@
 
 #include <rapidjson/error/en.h>
 
+#include <algorithm>
 #include <fstream>
-#include <sstream>
+#include <set>
+
+namespace {
+
+// 4-bit channel address of the ADC
+constexpr int max_adc_channels = 16;
+
+} // namespace
 
 Result<Config::Values> Config::load() {
-    std::ifstream file(m_path);
+    std::ifstream file(m_path, std::ios::binary | std::ios::ate);
     if (!file.good()) {
         return Result<Values>::Err(
             Error(__func__, "failed to open file \"" + m_path + "\""));
     }
 
-    std::ostringstream ss;
-    ss << file.rdbuf();
+    std::string buf(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(buf.data(), buf.size());
+    file.close();
 
     rapidjson::Document doc;
-    rapidjson::ParseResult res = doc.Parse(ss.str().c_str());
+    rapidjson::ParseResult res = doc.Parse(buf.data(), buf.size());
+
+    // the document owns copies of all strings, the raw text is not needed
+    std::string().swap(buf);
 
     if (!res) {
         std::string err_str =
@@ -59,13 +72,113 @@ Result<Config::Values> Config::load() {
     values.m_log_level_str = log_level_str_res.unwrap();
     values.m_driver_str = driver_str_res.unwrap();
 
+    // location is only needed for sunrise/sunset rules
+    if (doc.HasMember("location")) {
+        Result<const rapidjson::Value*> location_res =
+            read_object(doc, "location");
+        if (!location_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, location_res));
+        }
+
+        const rapidjson::Value& location_doc = *location_res.unwrap();
+
+        Result<double> latitude_res = read_double(location_doc, "latitude");
+        if (!latitude_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, latitude_res));
+        }
+
+        Result<double> longitude_res = read_double(location_doc, "longitude");
+        if (!longitude_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, longitude_res));
+        }
+
+        Rule::Location location;
+        location.m_latitude = latitude_res.unwrap();
+        location.m_longitude = longitude_res.unwrap();
+        values.m_location = location;
+    }
+
+    if (doc.HasMember("schedule_dir")) {
+        Result<std::string> schedule_dir_res = read_str(doc, "schedule_dir");
+        if (!schedule_dir_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, schedule_dir_res));
+        }
+
+        values.m_schedule_dir = schedule_dir_res.unwrap();
+    }
+
+    if (doc.HasMember("memory")) {
+        Result<const rapidjson::Value*> memory_res = read_object(doc, "memory");
+        if (!memory_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, memory_res));
+        }
+
+        const rapidjson::Value& memory_doc = *memory_res.unwrap();
+
+        Result<bool> low_memory_res = read_bool(memory_doc, "low_memory");
+        if (!low_memory_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, low_memory_res));
+        }
+
+        Result<int> thread_stack_res = read_int(memory_doc, "thread_stack_kb");
+        if (!thread_stack_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, thread_stack_res));
+        }
+
+        Result<bool> report_res = read_bool(memory_doc, "report");
+        if (!report_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, report_res));
+        }
+
+        if (thread_stack_res.unwrap() < 0) {
+            return Result<Values>::Err(
+                Error(__func__, "\"thread_stack_kb\" must not be negative"));
+        }
+
+        values.m_low_memory = low_memory_res.unwrap();
+        values.m_thread_stack_size =
+            static_cast<size_t>(thread_stack_res.unwrap()) * 1024;
+        values.m_memory_report = report_res.unwrap();
+    }
+
+    std::optional<PowerSampler::Params> telemetry;
+    if (doc.HasMember("telemetry")) {
+        Result<PowerSampler::Params> telemetry_res = read_telemetry(doc);
+        if (!telemetry_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, telemetry_res));
+        }
+
+        telemetry = telemetry_res.unwrap();
+    }
+
+    if (doc.HasMember("realtime")) {
+        Result<Realtime::Params> realtime_res = read_realtime(doc);
+        if (!realtime_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, realtime_res));
+        }
+
+        values.m_realtime = realtime_res.unwrap();
+    }
+
+    if (doc.HasMember("watchdog")) {
+        Result<Watchdog::Params> watchdog_res = read_watchdog(doc);
+        if (!watchdog_res.is_ok()) {
+            return Result<Values>::Err(Error(__func__, watchdog_res));
+        }
+
+        values.m_watchdog = watchdog_res.unwrap();
+    }
+
     std::string gateway_url = gateway_url_res.unwrap();
     std::string gateway_namespace = gateway_namespace_res.unwrap();
     int reconn_delay = reconn_delay_res.unwrap();
     int reconn_attempts = reconn_attempts_res.unwrap();
 
+    // two plugs with one id would share a gateway identity
+    std::set<std::string> device_ids;
+
     Result<> fe_res = for_each(
-        doc, "plugs", [&](const rapidjson::Document& plug_doc) -> Result<> {
+        doc, "plugs", [&](const rapidjson::Value& plug_doc) -> Result<> {
             Result<std::string> model_str_res = read_str(plug_doc, "model");
             if (!model_str_res.is_ok()) {
                 return Result<>::Err(Error(__func__, model_str_res));
@@ -86,6 +199,12 @@ Result<Config::Values> Config::load() {
                 return Result<>::Err(Error(__func__, device_id_res));
             }
 
+            if (!device_ids.insert(device_id_res.unwrap()).second) {
+                return Result<>::Err(
+                    Error(__func__, "duplicate \"device_id\" \"" +
+                                        device_id_res.unwrap() + "\""));
+            }
+
             Result<std::string> secret_res = read_str(plug_doc, "secret");
             if (!secret_res.is_ok()) {
                 return Result<>::Err(Error(__func__, secret_res));
@@ -104,6 +223,64 @@ Result<Config::Values> Config::load() {
             plug_config.m_reconn_delay = reconn_delay;
             plug_config.m_reconn_attempts = reconn_attempts;
 
+            if (plug_doc.HasMember("rate_limit")) {
+                Result<const rapidjson::Value*> rate_limit_res =
+                    read_object(plug_doc, "rate_limit");
+                if (!rate_limit_res.is_ok()) {
+                    return Result<>::Err(Error(__func__, rate_limit_res));
+                }
+
+                const rapidjson::Value& rate_limit_doc =
+                    *rate_limit_res.unwrap();
+
+                Result<double> rate_res = read_double(rate_limit_doc, "rate");
+                if (!rate_res.is_ok()) {
+                    return Result<>::Err(Error(__func__, rate_res));
+                }
+
+                Result<int> burst_res = read_int(rate_limit_doc, "burst");
+                if (!burst_res.is_ok()) {
+                    return Result<>::Err(Error(__func__, burst_res));
+                }
+
+                plug_config.m_rate_limit = rate_res.unwrap();
+                plug_config.m_rate_burst = burst_res.unwrap();
+            }
+
+            if (plug_doc.HasMember("adc_channel")) {
+                Result<int> adc_channel_res =
+                    read_int(plug_doc, "adc_channel");
+                if (!adc_channel_res.is_ok()) {
+                    return Result<>::Err(Error(__func__, adc_channel_res));
+                }
+
+                if (adc_channel_res.unwrap() < 0 ||
+                    adc_channel_res.unwrap() >= max_adc_channels) {
+                    return Result<>::Err(
+                        Error(__func__, "\"adc_channel\" out of range"));
+                }
+
+                plug_config.m_adc_channel = adc_channel_res.unwrap();
+            }
+
+            if (plug_doc.HasMember("schedule")) {
+                Result<> schedule_res = for_each(
+                    plug_doc, "schedule",
+                    [&](const rapidjson::Value& rule_doc) -> Result<> {
+                        Result<Rule::Spec> spec_res =
+                            read_rule_spec(rule_doc, values.m_location);
+                        if (!spec_res.is_ok()) {
+                            return Result<>::Err(Error(__func__, spec_res));
+                        }
+
+                        plug_config.m_schedule.push_back(spec_res.unwrap());
+                        return Result<>::Ok(None{});
+                    });
+                if (!schedule_res.is_ok()) {
+                    return Result<>::Err(Error(__func__, schedule_res));
+                }
+            }
+
             values.m_plugs.push_back(plug_config);
 
             return Result<>::Ok(None{});
@@ -112,12 +289,25 @@ Result<Config::Values> Config::load() {
         return Result<Values>::Err(Error(__func__, fe_res));
     }
 
+    // sample as many channels as the highest one in use
+    unsigned int channels = 0;
+    for (const Plug::Config& pc : values.m_plugs) {
+        channels = std::max(channels, static_cast<unsigned int>(
+                                          pc.m_adc_channel + 1));
+    }
+
+    if (telemetry && channels > 0) {
+        telemetry->m_adc.m_channels = channels;
+        telemetry->m_meter.m_channels = channels;
+        values.m_telemetry = telemetry;
+    }
+
     return Result<Values>::Ok(values);
 }
 
 std::string Config::to_str() { return ""; }
 
-Result<std::string> Config::read_str(const rapidjson::Document& doc,
+Result<std::string> Config::read_str(const rapidjson::Value& doc,
                                      const std::string& key) {
     if (!doc.HasMember(key.c_str()) || !doc[key.c_str()].IsString()) {
         return Result<std::string>::Err(
@@ -127,7 +317,7 @@ Result<std::string> Config::read_str(const rapidjson::Document& doc,
     return Result<std::string>::Ok(std::string(doc[key.c_str()].GetString()));
 }
 
-Result<int> Config::read_int(const rapidjson::Document& doc,
+Result<int> Config::read_int(const rapidjson::Value& doc,
                              const std::string& key) {
     if (!doc.HasMember(key.c_str()) || !doc[key.c_str()].IsInt()) {
         return Result<int>::Err(
@@ -137,7 +327,17 @@ Result<int> Config::read_int(const rapidjson::Document& doc,
     return Result<int>::Ok(doc[key.c_str()].GetInt());
 }
 
-Result<bool> Config::read_bool(const rapidjson::Document& doc,
+Result<double> Config::read_double(const rapidjson::Value& doc,
+                                   const std::string& key) {
+    if (!doc.HasMember(key.c_str()) || !doc[key.c_str()].IsNumber()) {
+        return Result<double>::Err(
+            Error(__func__, "failed to read required number \"" + key + "\""));
+    }
+
+    return Result<double>::Ok(doc[key.c_str()].GetDouble());
+}
+
+Result<bool> Config::read_bool(const rapidjson::Value& doc,
                                const std::string& key) {
     if (!doc.HasMember(key.c_str()) || !doc[key.c_str()].IsBool()) {
         return Result<bool>::Err(
@@ -147,21 +347,229 @@ Result<bool> Config::read_bool(const rapidjson::Document& doc,
     return Result<bool>::Ok(doc[key.c_str()].GetBool());
 }
 
-Result<> Config::read_object(const rapidjson::Document& doc,
-                             const std::string& key,
-                             rapidjson::Document& res_doc_ref) {
+Result<const rapidjson::Value*>
+Config::read_object(const rapidjson::Value& doc, const std::string& key) {
     if (!doc.HasMember(key.c_str()) || !doc[key.c_str()].IsObject()) {
-        return Result<>::Err(
+        return Result<const rapidjson::Value*>::Err(
             Error(__func__, "failed to read required object \"" + key + "\""));
     }
 
-    res_doc_ref.CopyFrom(doc[key.c_str()], res_doc_ref.GetAllocator());
-    return Result<>::Ok(None{});
+    return Result<const rapidjson::Value*>::Ok(&doc[key.c_str()]);
+}
+
+Result<PowerSampler::Params>
+Config::read_telemetry(const rapidjson::Value& doc) {
+    Result<const rapidjson::Value*> telemetry_res =
+        read_object(doc, "telemetry");
+    if (!telemetry_res.is_ok()) {
+        return Result<PowerSampler::Params>::Err(
+            Error(__func__, telemetry_res));
+    }
+
+    const rapidjson::Value& telemetry_doc = *telemetry_res.unwrap();
+
+    Result<int> sample_rate_res = read_int(telemetry_doc, "sample_rate");
+    if (!sample_rate_res.is_ok()) {
+        return Result<PowerSampler::Params>::Err(
+            Error(__func__, sample_rate_res));
+    }
+
+    Result<int> window_ms_res = read_int(telemetry_doc, "window_ms");
+    if (!window_ms_res.is_ok()) {
+        return Result<PowerSampler::Params>::Err(
+            Error(__func__, window_ms_res));
+    }
+
+    Result<int> publish_ms_res = read_int(telemetry_doc, "publish_ms");
+    if (!publish_ms_res.is_ok()) {
+        return Result<PowerSampler::Params>::Err(
+            Error(__func__, publish_ms_res));
+    }
+
+    Result<int> spi_channel_res = read_int(telemetry_doc, "spi_channel");
+    if (!spi_channel_res.is_ok()) {
+        return Result<PowerSampler::Params>::Err(
+            Error(__func__, spi_channel_res));
+    }
+
+    Result<int> spi_baud_res = read_int(telemetry_doc, "spi_baud");
+    if (!spi_baud_res.is_ok()) {
+        return Result<PowerSampler::Params>::Err(Error(__func__, spi_baud_res));
+    }
+
+    if (sample_rate_res.unwrap() <= 0 || window_ms_res.unwrap() <= 0 ||
+        publish_ms_res.unwrap() <= 0 || spi_channel_res.unwrap() < 0 ||
+        spi_baud_res.unwrap() <= 0) {
+        return Result<PowerSampler::Params>::Err(
+            Error(__func__, "telemetry value out of range"));
+    }
+
+    Result<double> voltage_res = read_double(telemetry_doc, "voltage");
+    if (!voltage_res.is_ok()) {
+        return Result<PowerSampler::Params>::Err(Error(__func__, voltage_res));
+    }
+
+    Result<double> amps_per_count_res =
+        read_double(telemetry_doc, "amps_per_count");
+    if (!amps_per_count_res.is_ok()) {
+        return Result<PowerSampler::Params>::Err(
+            Error(__func__, amps_per_count_res));
+    }
+
+    // channel count is filled in once the plugs are read
+    PowerSampler::Params params;
+    params.m_adc.m_channels = 0;
+    params.m_adc.m_spi_channel = spi_channel_res.unwrap();
+    params.m_adc.m_spi_baud = spi_baud_res.unwrap();
+    params.m_adc.m_sample_rate = sample_rate_res.unwrap();
+
+    params.m_meter.m_channels = 0;
+    params.m_meter.m_sample_rate = sample_rate_res.unwrap();
+    params.m_meter.m_window_ms = window_ms_res.unwrap();
+    params.m_meter.m_voltage = voltage_res.unwrap();
+    params.m_meter.m_amps_per_count = amps_per_count_res.unwrap();
+
+    params.m_publish_ms = publish_ms_res.unwrap();
+
+    return Result<PowerSampler::Params>::Ok(params);
+}
+
+Result<Realtime::Params> Config::read_realtime(const rapidjson::Value& doc) {
+    Result<const rapidjson::Value*> realtime_res = read_object(doc, "realtime");
+    if (!realtime_res.is_ok()) {
+        return Result<Realtime::Params>::Err(Error(__func__, realtime_res));
+    }
+
+    const rapidjson::Value& realtime_doc = *realtime_res.unwrap();
+
+    Result<bool> enabled_res = read_bool(realtime_doc, "enabled");
+    if (!enabled_res.is_ok()) {
+        return Result<Realtime::Params>::Err(Error(__func__, enabled_res));
+    }
+
+    Result<int> priority_res = read_int(realtime_doc, "priority");
+    if (!priority_res.is_ok()) {
+        return Result<Realtime::Params>::Err(Error(__func__, priority_res));
+    }
+
+    Result<int> cpu_res = read_int(realtime_doc, "cpu");
+    if (!cpu_res.is_ok()) {
+        return Result<Realtime::Params>::Err(Error(__func__, cpu_res));
+    }
+
+    Result<bool> lock_memory_res = read_bool(realtime_doc, "lock_memory");
+    if (!lock_memory_res.is_ok()) {
+        return Result<Realtime::Params>::Err(Error(__func__, lock_memory_res));
+    }
+
+    if (priority_res.unwrap() < 1 || priority_res.unwrap() > 99) {
+        return Result<Realtime::Params>::Err(
+            Error(__func__, "\"priority\" must be between 1 and 99"));
+    }
+
+    if (cpu_res.unwrap() < -1) {
+        return Result<Realtime::Params>::Err(
+            Error(__func__, "\"cpu\" must be -1 or a CPU index"));
+    }
+
+    Realtime::Params params;
+    params.m_enabled = enabled_res.unwrap();
+    params.m_priority = priority_res.unwrap();
+    params.m_cpu = cpu_res.unwrap();
+    params.m_lock_memory = lock_memory_res.unwrap();
+
+    return Result<Realtime::Params>::Ok(params);
+}
+
+Result<Watchdog::Params> Config::read_watchdog(const rapidjson::Value& doc) {
+    Result<const rapidjson::Value*> watchdog_res = read_object(doc, "watchdog");
+    if (!watchdog_res.is_ok()) {
+        return Result<Watchdog::Params>::Err(Error(__func__, watchdog_res));
+    }
+
+    const rapidjson::Value& watchdog_doc = *watchdog_res.unwrap();
+
+    Result<int> stall_ms_res = read_int(watchdog_doc, "stall_ms");
+    if (!stall_ms_res.is_ok()) {
+        return Result<Watchdog::Params>::Err(Error(__func__, stall_ms_res));
+    }
+
+    Result<int> check_ms_res = read_int(watchdog_doc, "check_ms");
+    if (!check_ms_res.is_ok()) {
+        return Result<Watchdog::Params>::Err(Error(__func__, check_ms_res));
+    }
+
+    Result<std::string> device_res = read_str(watchdog_doc, "device");
+    if (!device_res.is_ok()) {
+        return Result<Watchdog::Params>::Err(Error(__func__, device_res));
+    }
+
+    // waiting threads publish their deadline, any margin past it works
+    if (stall_ms_res.unwrap() <= 0) {
+        return Result<Watchdog::Params>::Err(
+            Error(__func__, "\"stall_ms\" must be positive"));
+    }
+
+    if (check_ms_res.unwrap() <= 0) {
+        return Result<Watchdog::Params>::Err(
+            Error(__func__, "\"check_ms\" must be positive"));
+    }
+
+    Watchdog::Params params;
+    params.m_stall_ms = stall_ms_res.unwrap();
+    params.m_check_ms = check_ms_res.unwrap();
+    params.m_device_path = device_res.unwrap();
+
+    return Result<Watchdog::Params>::Ok(params);
+}
+
+Result<Rule::Spec>
+Config::read_rule_spec(const rapidjson::Value& doc,
+                       const std::optional<Rule::Location>& location) {
+    Rule::Spec spec;
+
+    Result<std::string> command_res = read_str(doc, "command");
+    if (!command_res.is_ok()) {
+        return Result<Rule::Spec>::Err(Error(__func__, command_res));
+    }
+    spec.m_command = command_res.unwrap();
+
+    if (doc.HasMember("cron")) {
+        Result<std::string> cron_res = read_str(doc, "cron");
+        if (!cron_res.is_ok()) {
+            return Result<Rule::Spec>::Err(Error(__func__, cron_res));
+        }
+        spec.m_cron = cron_res.unwrap();
+    }
+
+    if (doc.HasMember("sun")) {
+        Result<std::string> sun_res = read_str(doc, "sun");
+        if (!sun_res.is_ok()) {
+            return Result<Rule::Spec>::Err(Error(__func__, sun_res));
+        }
+        spec.m_sun = sun_res.unwrap();
+    }
+
+    if (doc.HasMember("offset")) {
+        Result<int> offset_res = read_int(doc, "offset");
+        if (!offset_res.is_ok()) {
+            return Result<Rule::Spec>::Err(Error(__func__, offset_res));
+        }
+        spec.m_offset = offset_res.unwrap();
+    }
+
+    // validate now rather than when the plug starts
+    Result<Rule> rule_res = Rule::parse(spec, location);
+    if (!rule_res.is_ok()) {
+        return Result<Rule::Spec>::Err(Error(__func__, rule_res));
+    }
+
+    return Result<Rule::Spec>::Ok(spec);
 }
 
 Result<>
-Config::for_each(const rapidjson::Document& doc, const std::string& key,
-                 std::function<Result<>(const rapidjson::Document&)> callback) {
+Config::for_each(const rapidjson::Value& doc, const std::string& key,
+                 std::function<Result<>(const rapidjson::Value&)> callback) {
     if (!doc.HasMember(key.c_str()) || !doc[key.c_str()].IsArray()) {
         return Result<>::Err(
             Error(__func__, "failed to read required array \"" + key + "\""));
@@ -173,10 +581,7 @@ Config::for_each(const rapidjson::Document& doc, const std::string& key,
                 __func__, "array \"" + key + "\" contains invalid member"));
         }
 
-        rapidjson::Document res_doc;
-        res_doc.CopyFrom(member, res_doc.GetAllocator());
-
-        Result<> cb_res = callback(res_doc);
+        Result<> cb_res = callback(member);
         if (!cb_res.is_ok()) {
             return Result<>::Err(Error(__func__, cb_res));
         }
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "plug.h"
+#include "realtime.h"
+#include "scheduler/rule.h"
+#include "telemetry/power_sampler.h"
+#include "watchdog/watchdog.h"
 
 #include <homecontroller/util/result.h>
 
@@ -13,6 +17,24 @@ class Config {
         std::string m_log_level_str;
         std::string m_driver_str;
         std::vector<Plug::Config> m_plugs;
+
+        std::optional<Rule::Location> m_location;
+
+        // schedules set by the gateway are kept here, empty if not kept
+        std::string m_schedule_dir;
+
+        // 0 keeps the system default
+        size_t m_thread_stack_size = 0;
+        bool m_low_memory = false;
+        bool m_memory_report = false;
+
+        // set if any plug has a current-sense channel
+        std::optional<PowerSampler::Params> m_telemetry;
+
+        // disabled unless configured
+        Realtime::Params m_realtime;
+
+        std::optional<Watchdog::Params> m_watchdog;
     };
 
     Config(const std::string& path) : m_path(path) {}
@@ -22,18 +44,27 @@ class Config {
     std::string to_str();
 
   private:
-    Result<std::string> read_str(const rapidjson::Document& doc,
+    Result<std::string> read_str(const rapidjson::Value& doc,
                                  const std::string& key);
-    Result<int> read_int(const rapidjson::Document& doc,
+    Result<int> read_int(const rapidjson::Value& doc,
                          const std::string& key);
-    Result<bool> read_bool(const rapidjson::Document& doc,
+    Result<double> read_double(const rapidjson::Value& doc,
+                               const std::string& key);
+    Result<bool> read_bool(const rapidjson::Value& doc,
                            const std::string& key);
-    Result<> read_object(const rapidjson::Document& doc, const std::string& key,
-                         rapidjson::Document& res_doc_ref);
+    Result<const rapidjson::Value*> read_object(const rapidjson::Value& doc,
+                                                const std::string& key);
+
+    Result<PowerSampler::Params> read_telemetry(const rapidjson::Value& doc);
+    Result<Realtime::Params> read_realtime(const rapidjson::Value& doc);
+    Result<Watchdog::Params> read_watchdog(const rapidjson::Value& doc);
+    Result<Rule::Spec>
+    read_rule_spec(const rapidjson::Value& doc,
+                   const std::optional<Rule::Location>& location);
 
     Result<>
-    for_each(const rapidjson::Document& doc, const std::string& key,
-             std::function<Result<>(const rapidjson::Document&)> callback);
+    for_each(const rapidjson::Value& doc, const std::string& key,
+             std::function<Result<>(const rapidjson::Value&)> callback);
 
     std::string m_path;
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <homecontroller/util/logger.h>
 #include <homecontroller/util/result.h>
 
+#include <cstdint>
 #include <memory>
 
 class Driver {
@@ -11,6 +12,14 @@ class Driver {
 
     enum class Model { PLUG_V1 };
 
+    // current-sense ADC on the SPI bus
+    struct AdcParams {
+        unsigned int m_channels;
+        unsigned int m_spi_channel;
+        unsigned int m_spi_baud;
+        unsigned int m_sample_rate;
+    };
+
     static Result<Model> str_to_model(const std::string& str);
 
   protected:
@@ -26,6 +35,13 @@ class Driver {
     virtual Result<std::shared_ptr<HardwareInterface>>
     get_interface(const Model& model) = 0;
 
+    virtual bool open_adc(const AdcParams& params) = 0;
+    virtual void close_adc() = 0;
+
+    // reads one raw sample of every channel, only called from the sampling
+    // thread
+    virtual bool read_adc(uint16_t* samples) = 0;
+
   protected:
     hc::util::Logger m_logger;
 
@@ -1,7 +1,23 @@
 #include "rpi_z_driver.h"
 
+#include "../watchdog/heartbeat.h"
+
 #include <pigpio.h>
 
+namespace {
+
+// the current-sense ADC is a TI ADS7953 family part (ADS7950-ADS7961) in
+// Auto-2 mode: it steps through channels 0 to the programmed last one on its
+// own, one conversion per 16-bit frame. CS has to rise between frames
+constexpr uint16_t adc_program_auto2 = 0x9000; // last channel in bits 9-6
+constexpr uint16_t adc_mode_auto2 = 0x3C00;    // Auto-2, program, reset count
+constexpr uint16_t adc_continue = 0x0000;      // stay in the selected mode
+
+// a result comes out two frames after the one that selected its channel
+constexpr int adc_pipeline_frames = 2;
+
+} // namespace
+
 bool RPiZDriver::init() {
     if (m_init) {
         m_logger.error("init(): GPIO already initialized!");
@@ -25,6 +41,7 @@ void RPiZDriver::shutdown() {
         return;
     }
 
+    close_adc();
     gpioTerminate();
 
     m_logger.log("GPIO stopped");
@@ -42,12 +59,113 @@ RPiZDriver::get_interface(const Model& model) {
     }
 }
 
+bool RPiZDriver::open_adc(const AdcParams& params) {
+    if (!m_init) {
+        m_logger.error("open_adc(): GPIO not initialized!");
+        return false;
+    }
+
+    int handle = spiOpen(params.m_spi_channel, params.m_spi_baud, 0);
+    if (handle < 0) {
+        m_logger.error("open_adc(): Failed to open SPI channel " +
+                       std::to_string(params.m_spi_channel));
+        return false;
+    }
+
+    m_spi_handle = handle;
+    m_adc_params = params;
+    m_adc_tag_error = false;
+
+    // preallocated, read_adc runs at the sample rate
+    m_spi_tx = {static_cast<char>(adc_continue >> 8),
+                static_cast<char>(adc_continue & 0xFF)};
+    m_spi_rx.assign(params.m_channels * 2, 0);
+
+    // program the sequence length, then enter Auto-2 from channel 0 and let
+    // the pipeline fill so the first read is valid
+    uint16_t last_channel = static_cast<uint16_t>(params.m_channels - 1);
+    bool ok = xfer_adc_frame(adc_program_auto2 | (last_channel << 6)) &&
+              xfer_adc_frame(adc_mode_auto2);
+    for (int i = 0; ok && i < adc_pipeline_frames; i++) {
+        ok = xfer_adc_frame(adc_continue);
+    }
+
+    if (!ok) {
+        m_logger.error("open_adc(): Failed to configure ADC");
+        close_adc();
+        return false;
+    }
+
+    m_logger.log("ADC opened on SPI channel " +
+                 std::to_string(params.m_spi_channel));
+    return true;
+}
+
+void RPiZDriver::close_adc() {
+    if (m_spi_handle < 0) {
+        return;
+    }
+
+    spiClose(m_spi_handle);
+    m_spi_handle = -1;
+}
+
+bool RPiZDriver::read_adc(uint16_t* samples) {
+    if (m_spi_handle < 0) {
+        return false;
+    }
+
+    // one frame per channel, each its own transfer so CS rises in between
+    Heartbeat::mark("spi_xfer", "pigpio");
+    for (unsigned int c = 0; c < m_adc_params.m_channels; c++) {
+        int len = spiXfer(m_spi_handle, m_spi_tx.data(), &m_spi_rx[c * 2], 2);
+        if (len != 2) {
+            return false;
+        }
+    }
+
+    // channel address in the top 4 bits, 12-bit sample below. the sequence
+    // wraps, so a frame per channel holds every channel once in some order
+    uint32_t seen = 0;
+    for (unsigned int c = 0; c < m_adc_params.m_channels; c++) {
+        uint16_t word = static_cast<uint16_t>(
+            (static_cast<uint8_t>(m_spi_rx[c * 2]) << 8) |
+            static_cast<uint8_t>(m_spi_rx[c * 2 + 1]));
+
+        unsigned int tag = word >> 12;
+        if (tag >= m_adc_params.m_channels || (seen & (1u << tag))) {
+            // counted by the caller, logged only once
+            if (!m_adc_tag_error) {
+                m_adc_tag_error = true;
+                m_logger.error("read_adc(): Unexpected channel address " +
+                               std::to_string(tag) +
+                               ", the ADC is not in Auto-2 mode");
+            }
+            return false;
+        }
+
+        seen |= 1u << tag;
+        samples[tag] = word & 0x0FFF;
+    }
+
+    return true;
+}
+
+bool RPiZDriver::xfer_adc_frame(uint16_t word) {
+    char tx[2] = {static_cast<char>(word >> 8),
+                  static_cast<char>(word & 0xFF)};
+    char rx[2];
+
+    return spiXfer(m_spi_handle, tx, rx, 2) == 2;
+}
+
 void RPiZDriver::write() {
     if (!m_init) {
         m_logger.error("write(): GPIO not initialized!");
         return;
     }
 
+    Heartbeat::mark("gpio_write", "pigpio");
     if (gpioWrite(m_pin, m_value ? 1 : 0) != 0) {
         m_logger.error("write(): Write failed");
     }
@@ -2,6 +2,8 @@
 
 #include "driver.h"
 
+#include <vector>
+
 class RPiZDriver : public Driver,
                    public std::enable_shared_from_this<RPiZDriver> {
     struct Private {
@@ -11,7 +13,8 @@ class RPiZDriver : public Driver,
   public:
     class PlugV1Interface;
 
-    RPiZDriver(Private) : Driver("RPiZDriver") {}
+    RPiZDriver(Private)
+        : Driver("RPiZDriver"), m_spi_handle(-1), m_adc_tag_error(false) {}
     ~RPiZDriver() {}
 
     static std::shared_ptr<RPiZDriver> create() {
@@ -24,6 +27,10 @@ class RPiZDriver : public Driver,
     Result<std::shared_ptr<HardwareInterface>>
     get_interface(const Model& model) override;
 
+    bool open_adc(const AdcParams& params) override;
+    void close_adc() override;
+    bool read_adc(uint16_t* samples) override;
+
     std::shared_ptr<RPiZDriver> get_ptr() { return shared_from_this(); }
 
   private:
@@ -32,8 +39,17 @@ class RPiZDriver : public Driver,
     void set_pin(unsigned int pin) { m_pin = pin; }
     void set_value(bool value) { m_value = value; }
 
+    // sends one 16-bit frame, the reply is not needed
+    bool xfer_adc_frame(uint16_t word);
+
     unsigned int m_pin;
     bool m_value;
+
+    int m_spi_handle;
+    AdcParams m_adc_params;
+    std::vector<char> m_spi_tx; // one continue frame
+    std::vector<char> m_spi_rx; // a frame per channel
+    bool m_adc_tag_error;
 };
 
 class RPiZDriver::PlugV1Interface : public Driver::HardwareInterface {
@@ -1,5 +1,7 @@
 #include "test_driver.h"
 
+#include <cmath>
+
 bool TestDriver::init() {
     if (m_init) {
         m_logger.error("init(): Already initialized!");
@@ -33,12 +35,63 @@ TestDriver::get_interface(const Model& model) {
     }
 }
 
+bool TestDriver::open_adc(const AdcParams& params) {
+    if (!m_init) {
+        m_logger.error("open_adc(): Not initialized!");
+        return false;
+    }
+
+    m_adc_params = params;
+    m_adc_sample = 0;
+    m_adc_open = true;
+
+    m_logger.log("Synthetic ADC opened (" + std::to_string(params.m_channels) +
+                 " channel(s))");
+    return true;
+}
+
+void TestDriver::close_adc() { m_adc_open = false; }
+
+bool TestDriver::read_adc(uint16_t* samples) {
+    if (!m_adc_open) {
+        return false;
+    }
+
+    // 60 Hz sine around mid-scale of a 12-bit ADC, each channel drawing a
+    // different load, plus a little deterministic noise
+    constexpr double mains_hz = 60.0;
+    constexpr double mid_scale = 2048.0;
+
+    double t = static_cast<double>(m_adc_sample) / m_adc_params.m_sample_rate;
+    double phase = std::sin(2.0 * M_PI * mains_hz * t);
+
+    for (unsigned int c = 0; c < m_adc_params.m_channels; c++) {
+        double amplitude = 200.0 + 150.0 * c;
+        double noise = static_cast<double>((m_adc_sample * 7919 + c * 104729) %
+                                           17) -
+                       8.0;
+
+        samples[c] =
+            static_cast<uint16_t>(mid_scale + amplitude * phase + noise);
+    }
+
+    m_adc_sample++;
+    return true;
+}
+
 void TestDriver::write() {
     if (!m_init) {
         m_logger.error("write(): Not initialized!");
         return;
     }
 
+    // time is stored before the count so a reader seeing the new count
+    // also sees the new time
+    m_last_write_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count();
+    m_writes++;
+
     m_logger.verbose("write(): Write performed");
 }
 
@@ -2,6 +2,9 @@
 
 #include "driver.h"
 
+#include <atomic>
+#include <chrono>
+
 class TestDriver : public Driver,
                    public std::enable_shared_from_this<TestDriver> {
     struct Private {
@@ -11,7 +14,9 @@ class TestDriver : public Driver,
   public:
     class PlugV1Interface;
 
-    TestDriver(Private) : Driver("TestDriver") {}
+    TestDriver(Private)
+        : Driver("TestDriver"), m_adc_open(false), m_adc_sample(0),
+          m_writes(0), m_last_write_ns(0) {}
     ~TestDriver() {}
 
     static std::shared_ptr<TestDriver> create() {
@@ -24,10 +29,28 @@ class TestDriver : public Driver,
     Result<std::shared_ptr<HardwareInterface>>
     get_interface(const Model& model) override;
 
+    bool open_adc(const AdcParams& params) override;
+    void close_adc() override;
+    bool read_adc(uint16_t* samples) override;
+
     std::shared_ptr<TestDriver> get_ptr() { return shared_from_this(); }
 
+    // lets benchmarks see when the relay write happened
+    uint64_t get_write_count() const { return m_writes; }
+    std::chrono::steady_clock::time_point get_last_write_time() const {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::nanoseconds(m_last_write_ns.load()));
+    }
+
   private:
     void write() override;
+
+    bool m_adc_open;
+    AdcParams m_adc_params;
+    uint64_t m_adc_sample;
+
+    std::atomic<uint64_t> m_writes;
+    std::atomic<int64_t> m_last_write_ns;
 };
 
 class TestDriver::PlugV1Interface : public Driver::HardwareInterface {
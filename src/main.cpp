@@ -1,28 +1,53 @@
+#include "bench/jitter_bench.h"
+#include "bench/replay.h"
+#include "bench/telemetry_bench.h"
+#include "bench/wire_bench.h"
 #include "config.h"
 #include "driver/rpi_z_driver.h"
 #include "driver/test_driver.h"
+#include "memory.h"
 #include "plug.h"
+#include "realtime.h"
+#include "watchdog/watchdog.h"
 
 #include <homecontroller/util/string.h>
 
+#include <atomic>
 #include <csignal>
+#include <pthread.h>
 #include <thread>
 
 std::vector<std::unique_ptr<Plug>> g_plugs;
+std::atomic<bool> g_exiting(false);
+
+// default stack size in low memory mode, glibc reserves 8 MB otherwise
+constexpr size_t low_memory_thread_stack_size = 256 * 1024;
 
 struct CommandLineArgs {
     std::string m_config_path;
+    std::string m_record_path;
+    std::string m_replay_path;
+    std::string m_replay_mode;
+    std::string m_bench;
 };
 
 CommandLineArgs read_args(const hc::util::Logger& main_logger, int argc,
                           char* argv[]) {
     CommandLineArgs args;
     args.m_config_path = "conf/conf.json";
+    args.m_replay_mode = "fast";
 
     static std::map<std::string, std::function<void(const std::string&)>>
-        parse_map = {{"--conf-path", [&](const std::string& val) {
-                          args.m_config_path = val;
-                      }}};
+        parse_map = {
+            {"--conf-path",
+             [&](const std::string& val) { args.m_config_path = val; }},
+            {"--record",
+             [&](const std::string& val) { args.m_record_path = val; }},
+            {"--replay",
+             [&](const std::string& val) { args.m_replay_path = val; }},
+            {"--replay-mode",
+             [&](const std::string& val) { args.m_replay_mode = val; }},
+            {"--bench", [&](const std::string& val) { args.m_bench = val; }}};
 
     for (int i = 1; i < argc; i++) {
         std::string arg_str(argv[i]);
@@ -42,6 +67,17 @@ CommandLineArgs read_args(const hc::util::Logger& main_logger, int argc,
     }
 
     std::string args_str = "\n\tconf-path=" + args.m_config_path;
+    if (!args.m_record_path.empty()) {
+        args_str += "\n\trecord=" + args.m_record_path;
+    }
+    if (!args.m_replay_path.empty()) {
+        args_str += "\n\treplay=" + args.m_replay_path +
+                    "\n\treplay-mode=" + args.m_replay_mode;
+    }
+
+    if (!args.m_bench.empty()) {
+        args_str += "\n\tbench=" + args.m_bench;
+    }
 
     main_logger.log("Starting with arguments: " + args_str);
 
@@ -62,6 +98,20 @@ Result<std::shared_ptr<Driver>> get_driver(const std::string& name) {
     return Result<std::shared_ptr<Driver>>::Ok(mit->second());
 }
 
+Result<> run_bench(const std::string& name) {
+    static std::map<std::string, std::function<Result<>()>> str_to_bench_map =
+        {{"jitter", []() { return JitterBench(2000, 5).run(); }},
+         {"telemetry", []() { return TelemetryBench(8, 4000, 60).run(); }},
+         {"wire", []() { return WireBench(1000000).run(); }}};
+
+    auto mit = str_to_bench_map.find(name);
+    if (mit == str_to_bench_map.end()) {
+        return Result<>::Err(Error(__func__, "invalid benchmark name"));
+    }
+
+    return mit->second();
+}
+
 int main(int argc, char* argv[]) {
     hc::util::Logger main_logger = hc::util::Logger("Main");
 
@@ -70,6 +120,8 @@ int main(int argc, char* argv[]) {
     main_logger.log("RGBLights for HomeController v1.0.0");
     main_logger.log("Created by Josh Dittmer");
 
+    MemoryReport memory_report;
+
     // load config
     Config config = Config(args.m_config_path);
     Result<Config::Values> config_res = config.load();
@@ -85,6 +137,87 @@ int main(int argc, char* argv[]) {
     hc::util::Logger::set_log_level(hc::util::Logger::string_to_log_level(
         main_logger, config_values.m_log_level_str));
 
+    // must happen before the first thread is started
+    size_t thread_stack_size = config_values.m_thread_stack_size;
+    if (config_values.m_low_memory) {
+        main_logger.log("Low memory mode enabled");
+        Memory::enable_low_memory();
+
+        if (thread_stack_size == 0) {
+            thread_stack_size = low_memory_thread_stack_size;
+        }
+    }
+
+    // with locked memory every thread stack is resident in full
+    bool lock_memory = config_values.m_realtime.m_enabled &&
+                       config_values.m_realtime.m_lock_memory;
+    if (lock_memory && thread_stack_size == 0) {
+        thread_stack_size = low_memory_thread_stack_size;
+    }
+
+    if (thread_stack_size != 0 &&
+        !Memory::set_thread_stack_size(thread_stack_size)) {
+        main_logger.warn("Failed to set thread stack size");
+    }
+
+    // drop the parse buffers freed by Config::load
+    Memory::trim();
+
+    memory_report.mark("config", std::to_string(config_values.m_plugs.size()) +
+                                     " plug config(s)");
+
+    if (!args.m_bench.empty()) {
+        Result<> bench_res = run_bench(args.m_bench);
+        if (!bench_res.is_ok()) {
+            main_logger.fatal("Benchmark failed: " + bench_res.unwrap_err());
+            return -1;
+        }
+
+        return 0;
+    }
+
+    if (!args.m_replay_path.empty()) {
+        Result<Replay::Mode> mode_res = Replay::str_to_mode(args.m_replay_mode);
+        if (!mode_res.is_ok()) {
+            main_logger.fatal("Failed to start replay: " +
+                              mode_res.unwrap_err());
+            return -1;
+        }
+
+        Replay replay(args.m_replay_path, mode_res.unwrap());
+        Result<> replay_res = replay.run(config_values.m_plugs);
+        if (!replay_res.is_ok()) {
+            main_logger.fatal("Replay failed: " + replay_res.unwrap_err());
+            return -1;
+        }
+
+        return 0;
+    }
+
+    if (lock_memory) {
+        Realtime::lock_memory(main_logger);
+    }
+
+    // SIGINT is taken on a dedicated thread, shutdown locks the plugs and
+    // must not run in signal context. blocked before any thread is started
+    // so that every thread inherits the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    std::shared_ptr<Watchdog> watchdog;
+    if (config_values.m_watchdog) {
+        watchdog = std::make_shared<Watchdog>(*config_values.m_watchdog);
+        if (!watchdog->start()) {
+            main_logger.error("Failed to start watchdog!");
+            main_logger.fatal("Plug exited with non-zero status code");
+            return -1;
+        }
+
+        memory_report.mark("watchdog");
+    }
+
     Result<std::shared_ptr<Driver>> driver_res =
         get_driver(config_values.m_driver_str);
     if (!driver_res.is_ok()) {
@@ -100,15 +233,97 @@ int main(int argc, char* argv[]) {
         return -1;
     }
 
+    memory_report.mark("driver");
+
+    std::shared_ptr<Scheduler> scheduler =
+        std::make_shared<Scheduler>(config_values.m_location);
+    if (!scheduler->start()) {
+        main_logger.error("Failed to start scheduler!");
+        main_logger.fatal("Plug exited with non-zero status code");
+        return -1;
+    }
+
+    memory_report.mark("scheduler");
+
+    std::shared_ptr<PowerSampler> sampler;
+    if (config_values.m_telemetry) {
+        sampler = std::make_shared<PowerSampler>(*config_values.m_telemetry,
+                                                 driver);
+        if (!sampler->start()) {
+            main_logger.error("Failed to start power sampler!");
+            main_logger.fatal("Plug exited with non-zero status code");
+            return -1;
+        }
+
+        memory_report.mark("telemetry");
+    }
+
+    std::shared_ptr<Recorder> recorder;
+    if (!args.m_record_path.empty()) {
+        recorder = std::make_shared<Recorder>(args.m_record_path);
+        if (!recorder->start()) {
+            main_logger.error("Failed to start recorder!");
+            main_logger.fatal("Plug exited with non-zero status code");
+            return -1;
+        }
+
+        memory_report.mark("recorder");
+    }
+
+    Plug::Services services;
+    services.m_driver = driver;
+    services.m_scheduler = scheduler;
+    if (!config_values.m_schedule_dir.empty()) {
+        services.m_schedule_store =
+            std::make_shared<ScheduleStore>(config_values.m_schedule_dir);
+    }
+    services.m_recorder = recorder;
+    services.m_sampler = sampler;
+    services.m_realtime = config_values.m_realtime;
+
     std::vector<std::thread> threads;
     for (const Plug::Config& pc : config_values.m_plugs) {
         std::unique_ptr<Plug>& plug_ptr =
             g_plugs.emplace_back(std::make_unique<Plug>(pc));
 
-        threads.emplace_back(&Plug::init, plug_ptr.get(), driver);
+        threads.emplace_back(&Plug::init, plug_ptr.get(), services);
     }
 
-    std::signal(SIGINT, [](int s) {
+    // every plug holds its own copy from here on
+    size_t plug_count = config_values.m_plugs.size();
+    std::vector<Plug::Config>().swap(config_values.m_plugs);
+
+    // the clients allocate their threads and buffers in start
+    for (const auto& p : g_plugs) {
+        p->await_started();
+    }
+
+    if (config_values.m_low_memory) {
+        Memory::trim();
+    }
+
+    // every hc::api::Device runs its own gateway client with its own
+    // threads and buffers, the stack size is the only knob reaching them
+    memory_report.mark(
+        "plugs", std::to_string(plug_count) +
+                     " plug(s) with a gateway client each, thread stacks " +
+                     std::to_string(Memory::get_thread_stack_size() / 1024) +
+                     " kB reserved each");
+
+    if (config_values.m_memory_report) {
+        memory_report.log(main_logger);
+    }
+
+    std::thread signal_thread([&signals]() {
+        int sig;
+        sigwait(&signals, &sig);
+        if (g_exiting) {
+            return;
+        }
+
+        Heartbeat heartbeat("signal");
+        heartbeat.beat("shutdown", "Plug::m_mutex");
+
         for (const auto& p : g_plugs) {
             p->shutdown();
         }
@@ -120,8 +335,26 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // wake the signal thread if the plugs exited on their own
+    g_exiting = true;
+    pthread_kill(signal_thread.native_handle(), SIGINT);
+    signal_thread.join();
+
+    if (recorder) {
+        recorder->shutdown();
+    }
+
+    if (sampler) {
+        sampler->shutdown();
+    }
+
+    scheduler->shutdown();
     driver->shutdown();
 
+    if (watchdog) {
+        watchdog->shutdown();
+    }
+
     main_logger.log("Plug stopped, exiting gracefully");
 
     return 0;
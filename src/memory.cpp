@@ -0,0 +1,88 @@
+#include "memory.h"
+
+#include <fstream>
+#include <malloc.h>
+#include <pthread.h>
+
+namespace {
+
+constexpr int low_memory_arenas = 2;
+constexpr int low_memory_trim_threshold = 64 * 1024;
+
+} // namespace
+
+bool Memory::set_thread_stack_size(size_t bytes) {
+    if (bytes < static_cast<size_t>(PTHREAD_STACK_MIN)) {
+        bytes = PTHREAD_STACK_MIN;
+    }
+
+    pthread_attr_t attr;
+    if (pthread_getattr_default_np(&attr) != 0) {
+        return false;
+    }
+
+    bool ok = pthread_attr_setstacksize(&attr, bytes) == 0 &&
+              pthread_setattr_default_np(&attr) == 0;
+
+    pthread_attr_destroy(&attr);
+    return ok;
+}
+
+size_t Memory::get_thread_stack_size() {
+    pthread_attr_t attr;
+    if (pthread_getattr_default_np(&attr) != 0) {
+        return 0;
+    }
+
+    size_t bytes = 0;
+    pthread_attr_getstacksize(&attr, &bytes);
+    pthread_attr_destroy(&attr);
+
+    return bytes;
+}
+
+void Memory::enable_low_memory() {
+    // every thread otherwise gets its own arena on first malloc
+    mallopt(M_ARENA_MAX, low_memory_arenas);
+    mallopt(M_TRIM_THRESHOLD, low_memory_trim_threshold);
+}
+
+void Memory::trim() { malloc_trim(0); }
+
+long Memory::read_rss_kb() {
+    std::ifstream status("/proc/self/status");
+
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+
+    return -1;
+}
+
+void MemoryReport::mark(const std::string& subsystem,
+                        const std::string& detail) {
+    long rss_kb = Memory::read_rss_kb();
+    m_entries.push_back({subsystem, rss_kb - m_last_rss_kb, detail});
+    m_last_rss_kb = rss_kb;
+}
+
+void MemoryReport::log(const hc::util::Logger& logger) const {
+    logger.log("Memory report (RSS):");
+    logger.log("\tbaseline: " + std::to_string(m_start_rss_kb) + " kB");
+
+    for (const Entry& entry : m_entries) {
+        std::string line = "\t" + entry.m_subsystem + ": " +
+                           (entry.m_delta_kb >= 0 ? "+" : "") +
+                           std::to_string(entry.m_delta_kb) + " kB";
+        if (!entry.m_detail.empty()) {
+            line += " (" + entry.m_detail + ")";
+        }
+
+        logger.log(line);
+    }
+
+    logger.log("\ttotal: " + std::to_string(m_last_rss_kb) + " kB");
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <homecontroller/util/logger.h>
+
+#include <string>
+#include <vector>
+
+class Memory {
+  public:
+    // applies to every thread created afterwards, library threads included
+    static bool set_thread_stack_size(size_t bytes);
+    static size_t get_thread_stack_size();
+
+    // fewer malloc arenas and a lower trim threshold, must be called before
+    // any thread is started
+    static void enable_low_memory();
+
+    // returns freed heap memory to the system
+    static void trim();
+
+    // resident set size of the process, -1 if unavailable
+    static long read_rss_kb();
+};
+
+// Attributes RSS growth during startup to the subsystem started in between.
+class MemoryReport {
+  public:
+    MemoryReport()
+        : m_start_rss_kb(Memory::read_rss_kb()),
+          m_last_rss_kb(m_start_rss_kb) {}
+    ~MemoryReport() {}
+
+    void mark(const std::string& subsystem, const std::string& detail = "");
+    void log(const hc::util::Logger& logger) const;
+
+  private:
+    struct Entry {
+        std::string m_subsystem;
+        long m_delta_kb;
+        std::string m_detail;
+    };
+
+    std::vector<Entry> m_entries;
+
+    long m_start_rss_kb;
+    long m_last_rss_kb;
+};
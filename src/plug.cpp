@@ -2,45 +2,79 @@
 
 #include <thread>
 
-bool Plug::init(const std::shared_ptr<Driver>& driver) {
+namespace {
+
+// built once, nothing on the command path formats a string
+const std::string msg_power_on = "Power switched ON";
+const std::string msg_power_off = "Power switched OFF";
+const std::string msg_already_on = "execute_command(): Power already on!";
+const std::string msg_already_off = "execute_command(): Power already off!";
+const std::string msg_switching_on =
+    "execute_command(): Power is already switching on!";
+const std::string msg_switching_off =
+    "execute_command(): Power is already switching off!";
+const std::string msg_unknown_command = "execute_command(): Unknown command";
+
+// layout of Plug::m_pending, the time keeps its low 56 bits
+constexpr int pending_command_bits = 8;
+constexpr uint64_t pending_command_mask = (1ull << pending_command_bits) - 1;
+constexpr uint64_t pending_time_mask = ~0ull >> pending_command_bits;
+
+uint64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+bool Plug::init(const Services& services) {
     get_logger().log("Initialization started!");
 
-    Result<Driver::Model> model_res =
-        Driver::str_to_model(m_config.m_model_str);
-    if (!model_res.is_ok()) {
-        get_logger().error("Failed to get device model: " +
-                           model_res.unwrap_err());
+    if (!attach_interface(services.m_driver)) {
+        set_started();
         return false;
     }
 
-    Result<std::shared_ptr<Driver::HardwareInterface>> interface_res =
-        driver->get_interface(model_res.unwrap());
-    if (!interface_res.is_ok()) {
-        get_logger().error("Failed to get hardware interface: " +
-                           interface_res.unwrap_err());
-        return false;
+    // the client may deliver commands as soon as it is started
+    m_recorder = services.m_recorder;
+    m_realtime = services.m_realtime;
+    m_scheduler = services.m_scheduler;
+    m_schedule_store = services.m_schedule_store;
+    m_observer = services.m_observer;
+    if (m_config.m_adc_channel >= 0) {
+        m_sampler = services.m_sampler;
     }
 
-    get_logger().verbose("Using hardware interface for " +
-                         m_config.m_model_str);
-
-    m_interface = interface_res.unwrap();
-    m_interface->set_pin(m_config.m_gpio_pin);
-
-    // create initial state
-    hc::api::plug::State state;
-    state.m_power_state = hc::api::plug::State::PowerState::OFF;
-    state.m_lock_duration = m_config.m_lock_duration;
-
     // device opts
     Device::StartParams params;
     params.m_gateway = {m_config.m_gateway_url, m_config.m_gateway_namespace};
     params.m_device_id = m_config.m_device_id;
     params.m_secret = m_config.m_secret;
-    params.m_initial_state = state;
+    m_state = initial_state();
+    params.m_initial_state = m_state;
     params.m_reconn_delay = m_config.m_reconn_delay;
     params.m_reconn_attempts = m_config.m_reconn_attempts;
 
+    // the schedule last set by the gateway replaces the configured one
+    if (m_schedule_store) {
+        Result<std::optional<std::vector<Rule::Spec>>> stored_res =
+            m_schedule_store->load(m_config.m_device_id);
+        if (!stored_res.is_ok()) {
+            get_logger().error("Failed to load stored schedule: " +
+                               stored_res.unwrap_err());
+        } else if (stored_res.unwrap()) {
+            get_logger().log("Using stored schedule");
+            m_config.m_schedule = *stored_res.unwrap();
+        }
+    }
+
+    // rules keep firing while the gateway is unreachable
+    apply_schedule(m_config.m_schedule);
+
+    // nothing is negotiated before the gateway asks
+    m_encoding = wire::Encoding::JSON;
+
     // start main device loop
     start(params);
 
@@ -50,65 +84,316 @@ bool Plug::init(const std::shared_ptr<Driver>& driver) {
         loop_thread = std::thread(&Plug::loop, this);
     }
 
+    set_started();
+
     // blocks until device loop exits
     await_finish_and_cleanup();
 
     if (loop_thread.joinable()) {
         get_logger().verbose("Waiting for loop thread to exit...");
-        m_cv.notify_all();
+        {
+            std::lock_guard<PiMutex> lock(m_mutex);
+            m_cv.notify_all();
+        }
         loop_thread.join();
     }
 
+    m_scheduler->remove(m_config.m_device_id);
+
+    Stats stats = get_stats();
+    get_logger().log("Commands received: " + std::to_string(stats.m_received) +
+                     ", applied: " + std::to_string(stats.m_applied) +
+                     ", coalesced: " + std::to_string(stats.m_coalesced) +
+                     ", dropped: " + std::to_string(stats.m_dropped));
+
     return true;
 }
+
+void Plug::await_started() {
+    std::unique_lock<std::mutex> lock(m_started_mutex);
+    m_started_cv.wait(lock, [&]() { return m_started; });
+}
+
+void Plug::set_started() {
+    std::lock_guard<std::mutex> lock(m_started_mutex);
+    m_started = true;
+    m_started_cv.notify_all();
+}
+
 void Plug::shutdown() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    stop();
+    std::unique_lock<PiMutex> lock(m_mutex);
+
+    if (!m_offline) {
+        // the client thread takes the lock to deliver commands, stopping
+        // it while holding the lock could deadlock
+        lock.unlock();
+        stop();
+        return;
+    }
+
+    m_offline = false;
+    m_cv.notify_all();
+    lock.unlock();
+
+    if (m_offline_thread.joinable()) {
+        m_offline_thread.join();
+    }
+}
+
+bool Plug::init_offline(const Services& services) {
+    get_logger().log("Offline initialization started!");
+
+    if (!attach_interface(services.m_driver)) {
+        set_started();
+        return false;
+    }
+
+    m_recorder = services.m_recorder;
+    m_scheduler = services.m_scheduler;
+    m_observer = services.m_observer;
+    m_realtime = services.m_realtime;
+
+    m_state = initial_state();
+    update_state(m_state);
+
+    m_offline = true;
+    m_offline_thread = std::thread(&Plug::loop, this);
+    set_started();
+
+    return true;
+}
+
+bool Plug::attach_interface(const std::shared_ptr<Driver>& driver) {
+    Result<Driver::Model> model_res =
+        Driver::str_to_model(m_config.m_model_str);
+    if (!model_res.is_ok()) {
+        get_logger().error("Failed to get device model: " +
+                           model_res.unwrap_err());
+        return false;
+    }
+
+    Result<std::shared_ptr<Driver::HardwareInterface>> interface_res =
+        driver->get_interface(model_res.unwrap());
+    if (!interface_res.is_ok()) {
+        get_logger().error("Failed to get hardware interface: " +
+                           interface_res.unwrap_err());
+        return false;
+    }
+
+    get_logger().verbose("Using hardware interface for " +
+                         m_config.m_model_str);
+
+    m_interface = interface_res.unwrap();
+    m_interface->set_pin(m_config.m_gpio_pin);
+
+    return true;
+}
+
+hc::api::plug::State Plug::initial_state() const {
+    hc::api::plug::State state;
+    state.m_power_state = hc::api::plug::State::PowerState::OFF;
+    state.m_lock_duration = m_config.m_lock_duration;
+
+    return state;
 }
 
 void Plug::loop() {
-    while (is_client_running()) {
-        std::unique_lock<std::mutex> lock(m_mutex);
+    // before taking the lock, a failure only costs determinism
+    Realtime::apply_to_current_thread(m_realtime, get_logger());
+
+    Heartbeat heartbeat("plug " + m_config.m_device_id);
+    heartbeat.beat("acquire", "Plug::m_mutex");
+
+    std::unique_lock<PiMutex> lock(m_mutex);
+
+    std::chrono::steady_clock::time_point next_power_publish =
+        std::chrono::steady_clock::now();
+
+    while (is_active()) {
+        // re-checked under the lock so a notify cannot be missed
+        auto has_work = [&]() {
+            return !is_active() || m_pending != no_command;
+        };
+
+        // real-time only from waiting for a command to the relay write,
+        // logging and publishing run at normal priority
+        Realtime::set_priority(m_realtime, true);
+
+        heartbeat.beat("wait_command", "Plug::m_mutex");
+
+        if (m_sampler) {
+            if (!heartbeat.wait_until(m_cv, lock, next_power_publish,
+                                      has_work)) {
+                Realtime::set_priority(m_realtime, false);
+                next_power_publish +=
+                    std::chrono::milliseconds(m_sampler->get_publish_ms());
+                heartbeat.beat("publish_power");
+                publish_power();
+                continue;
+            }
+        } else {
+            heartbeat.wait(m_cv, lock, has_work);
+        }
 
-        m_cv.wait(lock);
-        if (!is_client_running()) {
+        if (!is_active()) {
+            Realtime::set_priority(m_realtime, false);
             return;
         }
 
+        // wait for a token, later commands keep coalescing meanwhile
+        TokenBucket::Clock::duration delay = m_limiter.time_until_token();
+        if (delay > TokenBucket::Clock::duration::zero()) {
+            Realtime::set_priority(m_realtime, false);
+            get_logger().verbose("loop(): Rate limited");
+            heartbeat.beat("rate_limited", "Plug::m_mutex");
+            heartbeat.wait_for(m_cv, lock, delay,
+                               [&]() { return !is_active(); });
+            continue;
+        }
+
+        uint64_t pending = m_pending.exchange(no_command);
+        if (pending == no_command) {
+            continue;
+        }
+
+        heartbeat.beat("execute");
+
+        hc::api::plug::State new_state = m_state;
+        const std::string* message = nullptr;
+        bool executed = execute_command(
+            static_cast<hc::api::plug::Command>(
+                (pending & pending_command_mask) - 1),
+            new_state, message);
+
+        Realtime::set_priority(m_realtime, false);
+
+        if (!executed) {
+            get_logger().debug(*message);
+            m_dropped++;
+            continue;
+        }
+
+        get_logger().log(*message);
+
+        m_limiter.consume();
+
+        heartbeat.beat("publish_state");
+        publish_state(new_state);
+        m_applied++;
+
+        if (m_observer) {
+            uint64_t since_ns = pending >> pending_command_bits;
+            m_observer->on_applied(
+                m_config.m_device_id,
+                std::chrono::nanoseconds((steady_now_ns() - since_ns) &
+                                         pending_time_mask));
+        }
+
         get_logger().verbose("loop(): Locking power state change");
 
-        lock.unlock();
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(m_config.m_lock_duration));
-        lock.lock();
+        heartbeat.beat("relay_locked", "Plug::m_mutex");
+        heartbeat.wait_for(m_cv, lock,
+                           std::chrono::milliseconds(m_config.m_lock_duration),
+                           [&]() { return !is_active(); });
 
         get_logger().verbose("loop(): Unlocking power state change");
 
-        hc::api::plug::State new_state = get_state();
+        new_state = m_state;
 
-        if (get_state().m_power_state ==
+        if (m_state.m_power_state ==
             hc::api::plug::State::PowerState::ON_LOCKED) {
             new_state.m_power_state = hc::api::plug::State::PowerState::ON;
-        } else if (get_state().m_power_state ==
+        } else if (m_state.m_power_state ==
                    hc::api::plug::State::PowerState::OFF_LOCKED) {
             new_state.m_power_state = hc::api::plug::State::PowerState::OFF;
         }
 
-        update_state(new_state);
+        heartbeat.beat("publish_state");
+        publish_state(new_state);
+    }
+}
+
+void Plug::publish_state(const hc::api::plug::State& state) {
+    m_state = state;
+
+    if (m_recorder) {
+        m_recorder->record_state(m_config.m_device_id, state);
     }
+
+    update_state(state);
+}
+
+void Plug::publish_power() {
+    PowerMeter::Stats stats = m_sampler->take_stats(
+        static_cast<unsigned int>(m_config.m_adc_channel));
+    if (stats.m_windows == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_power_mutex);
+        m_power = stats;
+    }
+
+    // unchanged power state, the aggregates ride along in serialize_state
+    publish_state(m_state);
 }
 
 void Plug::on_command_received(
     std::map<std::string, ::sio::message::ptr>& data) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
     get_logger().verbose("on_command_received(): Reading command...");
 
+    auto fit = data.find("frame");
+    if (fit != data.end() && fit->second &&
+        fit->second->get_flag() == ::sio::message::flag_binary) {
+        if (m_recorder) {
+            m_recorder->record_frame(m_config.m_device_id,
+                                     *fit->second->get_binary());
+        }
+
+        handle_frame(*fit->second->get_binary());
+        return;
+    }
+
+    if (m_recorder) {
+        m_recorder->record_command(m_config.m_device_id, data);
+    }
+
     std::string cmd_name = data["command"]->get_string();
 
     get_logger().verbose("on_command_received(): Command name is \"" +
                          cmd_name + "\"");
 
+    if (cmd_name == "set_schedule") {
+        get_logger().verbose(
+            "on_command_received(): Executing set schedule handler");
+
+        // parsed and queued without the plug lock, the loop thread keeps
+        // switching meanwhile
+        handle_set_schedule(data);
+        return;
+    }
+
+    if (cmd_name == "set_encoding") {
+        auto eit = data.find("encoding");
+        if (eit == data.end() || !eit->second ||
+            eit->second->get_flag() != ::sio::message::flag_string) {
+            get_logger().error("on_command_received(): Missing encoding");
+            return;
+        }
+
+        Result<wire::Encoding> encoding_res =
+            wire::str_to_encoding(eit->second->get_string());
+        if (!encoding_res.is_ok()) {
+            get_logger().error("on_command_received(): " +
+                               encoding_res.unwrap_err());
+            return;
+        }
+
+        set_encoding(encoding_res.unwrap());
+        return;
+    }
+
     Result<hc::api::plug::Command> cmd_res =
         hc::api::plug::string_to_command(cmd_name);
 
@@ -117,77 +402,238 @@ void Plug::on_command_received(
         return;
     }
 
-    hc::api::plug::State new_state = get_state();
-    bool needs_update = false;
+    submit_command(cmd_res.unwrap());
+}
+
+Plug::Stats Plug::get_stats() const {
+    Stats stats;
+    stats.m_received = m_received;
+    stats.m_coalesced = m_coalesced;
+    stats.m_dropped = m_dropped;
+    stats.m_applied = m_applied;
+
+    return stats;
+}
+
+::sio::message::ptr Plug::serialize_state() const {
+    std::lock_guard<std::mutex> lock(m_power_mutex);
+    const PowerMeter::Stats* power = m_power ? &*m_power : nullptr;
+
+    if (m_encoding == wire::Encoding::BINARY) {
+        return ::sio::binary_message::create(
+            std::make_shared<const std::string>(
+                wire::encode_state(get_state(), power)));
+    }
+
+    return wire::state_to_message(get_state(), power);
+}
 
-    switch (cmd_res.unwrap()) {
+void Plug::handle_frame(const std::string& bytes) {
+    Result<wire::Frame> frame_res =
+        wire::parse_frame(bytes.data(), bytes.size());
+    if (!frame_res.is_ok()) {
+        get_logger().error("handle_frame(): " + frame_res.unwrap_err());
+        return;
+    }
+
+    wire::Frame frame = frame_res.unwrap();
+
+    switch (frame.m_opcode) {
+    case wire::Opcode::POWER_ON:
+        submit_command(hc::api::plug::Command::PowerOn);
+        return;
+    case wire::Opcode::POWER_OFF:
+        submit_command(hc::api::plug::Command::PowerOff);
+        return;
+    case wire::Opcode::SET_ENCODING: {
+        wire::EncodingPayload payload;
+        if (!wire::read_payload(frame, 0, payload)) {
+            get_logger().error("handle_frame(): Truncated encoding payload");
+            return;
+        }
+
+        set_encoding(payload.m_encoding);
+        return;
+    }
+    default:
+        get_logger().verbose("handle_frame(): Unimplemented opcode " +
+                             std::to_string(static_cast<int>(frame.m_opcode)));
+        return;
+    }
+}
+
+void Plug::set_encoding(wire::Encoding encoding) {
+    if (encoding != wire::Encoding::JSON &&
+        encoding != wire::Encoding::BINARY) {
+        get_logger().error("set_encoding(): Unknown encoding");
+        return;
+    }
+
+    m_encoding = encoding;
+
+    get_logger().log(std::string("Using ") +
+                     (encoding == wire::Encoding::BINARY ? "binary" : "json") +
+                     " encoding");
+}
+
+void Plug::submit_command(hc::api::plug::Command cmd) {
+    m_received++;
+
+    uint64_t now_ns = steady_now_ns();
+
+    uint64_t prev = m_pending.load();
+    uint64_t next;
+    do {
+        // keeps the oldest time if commands coalesce
+        uint64_t since_ns =
+            prev == no_command ? now_ns : prev >> pending_command_bits;
+        next = (since_ns << pending_command_bits) |
+               (static_cast<uint64_t>(cmd) + 1);
+    } while (!m_pending.compare_exchange_weak(prev, next));
+
+    if (prev != no_command) {
+        // the loop thread was already woken for the earlier command
+        m_coalesced++;
+        return;
+    }
+
+    std::lock_guard<PiMutex> lock(m_mutex);
+    m_cv.notify_all();
+}
+
+bool Plug::execute_command(hc::api::plug::Command cmd,
+                           hc::api::plug::State& state,
+                           const std::string*& message) {
+    switch (cmd) {
     case hc::api::plug::Command::PowerOn:
-        get_logger().verbose(
-            "on_command_received(): Executing power on handler");
-        handle_power_on(new_state);
-        needs_update = true;
-        break;
+        return handle_power_on(state, message);
     case hc::api::plug::Command::PowerOff:
-        get_logger().verbose(
-            "on_command_received(): Executing power off handler");
-        handle_power_off(new_state);
-        needs_update = true;
-        break;
+        return handle_power_off(state, message);
     }
 
-    if (needs_update) {
-        update_state(new_state);
+    message = &msg_unknown_command;
+    return false;
+}
+
+void Plug::handle_set_schedule(
+    std::map<std::string, ::sio::message::ptr>& data) {
+    auto mit = data.find("schedule");
+    if (mit == data.end() || !mit->second ||
+        mit->second->get_flag() != ::sio::message::flag_array) {
+        get_logger().error("handle_set_schedule(): Missing schedule array");
+        return;
+    }
+
+    std::vector<Rule::Spec> specs;
+    for (const ::sio::message::ptr& rule_msg : mit->second->get_vector()) {
+        if (!rule_msg || rule_msg->get_flag() != ::sio::message::flag_object) {
+            get_logger().error("handle_set_schedule(): Invalid rule");
+            return;
+        }
+
+        std::map<std::string, ::sio::message::ptr>& rule_map =
+            rule_msg->get_map();
+
+        auto read_str = [&](const std::string& key, std::string& res) {
+            auto rit = rule_map.find(key);
+            if (rit != rule_map.end() && rit->second &&
+                rit->second->get_flag() == ::sio::message::flag_string) {
+                res = rit->second->get_string();
+            }
+        };
+
+        Rule::Spec spec;
+        read_str("command", spec.m_command);
+        read_str("cron", spec.m_cron);
+        read_str("sun", spec.m_sun);
+
+        auto oit = rule_map.find("offset");
+        if (oit != rule_map.end() && oit->second &&
+            oit->second->get_flag() == ::sio::message::flag_integer) {
+            spec.m_offset = static_cast<int>(oit->second->get_int());
+        }
+
+        specs.push_back(spec);
+    }
+
+    if (!apply_schedule(specs)) {
+        return;
+    }
+
+    // only read by init, before the client is started
+    m_config.m_schedule = specs;
+    get_logger().log("Schedule updated (" + std::to_string(specs.size()) +
+                     " rule(s))");
+
+    if (m_schedule_store) {
+        Result<> save_res = m_schedule_store->save(m_config.m_device_id, specs);
+        if (!save_res.is_ok()) {
+            get_logger().error("handle_set_schedule(): Schedule not stored, "
+                               "it is lost on restart: " +
+                               save_res.unwrap_err());
+        }
     }
 }
 
-::sio::message::ptr Plug::serialize_state() const {
-    ::sio::message::ptr state_msg = ::sio::object_message::create();
-    state_msg->get_map()["powerState"] = ::sio::string_message::create(
-        hc::api::plug::power_state_to_string(get_state().m_power_state));
-    state_msg->get_map()["lockDuration"] =
-        ::sio::int_message::create(get_state().m_lock_duration);
+bool Plug::apply_schedule(const std::vector<Rule::Spec>& specs) {
+    std::vector<Rule> rules;
+    for (const Rule::Spec& spec : specs) {
+        Result<Rule> rule_res =
+            Rule::parse(spec, m_scheduler->get_location());
+        if (!rule_res.is_ok()) {
+            get_logger().error("Invalid schedule rule: " +
+                               rule_res.unwrap_err());
+            return false;
+        }
+
+        rules.push_back(rule_res.unwrap());
+    }
+
+    m_scheduler->set_rules(
+        m_config.m_device_id, rules,
+        [this](hc::api::plug::Command cmd) { submit_command(cmd); });
 
-    return state_msg;
+    return true;
 }
 
-void Plug::handle_power_on(hc::api::plug::State& state) {
+bool Plug::handle_power_on(hc::api::plug::State& state,
+                           const std::string*& message) {
     if (state.m_power_state == hc::api::plug::State::PowerState::ON ||
         state.m_power_state == hc::api::plug::State::PowerState::ON_LOCKED) {
-        get_logger().debug("handle_power_on(): Power already on!");
-        return;
+        message = &msg_already_on;
+        return false;
     }
 
     if (state.m_power_state == hc::api::plug::State::PowerState::OFF_LOCKED) {
-        get_logger().debug(
-            "handle_power_on(): Power is already switching off!");
-        return;
+        message = &msg_switching_off;
+        return false;
     }
 
     m_interface->on();
 
     state.m_power_state = hc::api::plug::State::PowerState::ON_LOCKED;
-    m_cv.notify_all();
 
-    get_logger().log("Power switched ON");
+    message = &msg_power_on;
+    return true;
 }
 
-void Plug::handle_power_off(hc::api::plug::State& state) {
+bool Plug::handle_power_off(hc::api::plug::State& state,
+                            const std::string*& message) {
     if (state.m_power_state == hc::api::plug::State::PowerState::OFF ||
         state.m_power_state == hc::api::plug::State::PowerState::OFF_LOCKED) {
-        get_logger().debug("handle_power_off(): Power already off!");
-        return;
+        message = &msg_already_off;
+        return false;
     }
 
     if (state.m_power_state == hc::api::plug::State::PowerState::ON_LOCKED) {
-        get_logger().debug(
-            "handle_power_off(): Power is already switching on!");
-        return;
+        message = &msg_switching_on;
+        return false;
     }
 
     m_interface->off();
 
     state.m_power_state = hc::api::plug::State::PowerState::OFF_LOCKED;
-    m_cv.notify_all();
 
-    get_logger().log("Power switched OFF");
+    message = &msg_power_off;
+    return true;
 }
\ No newline at end of file
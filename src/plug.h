@@ -1,12 +1,23 @@
 #pragma once
 
+#include "capture/recorder.h"
 #include "driver/driver.h"
+#include "realtime.h"
+#include "scheduler/schedule_store.h"
+#include "scheduler/scheduler.h"
+#include "telemetry/power_sampler.h"
+#include "token_bucket.h"
+#include "watchdog/heartbeat.h"
+#include "wire/codec.h"
 
 #include <homecontroller/api/device.h>
 #include <homecontroller/api/device_data/plug.h>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 
 class Plug : public hc::api::Device<hc::api::plug::State> {
   public:
@@ -23,31 +34,160 @@ class Plug : public hc::api::Device<hc::api::plug::State> {
 
         int m_reconn_delay;
         int m_reconn_attempts;
+
+        std::vector<Rule::Spec> m_schedule;
+
+        // relay transitions per second, 0 means unlimited
+        double m_rate_limit = 0.0;
+        int m_rate_burst = 1;
+
+        // current-sense ADC channel, -1 if the outlet has none
+        int m_adc_channel = -1;
+    };
+
+    struct Stats {
+        uint64_t m_received;
+        uint64_t m_coalesced; // overwritten by a newer command before applied
+        uint64_t m_dropped;   // applied but already in the requested state
+        uint64_t m_applied;
+    };
+
+    // notified on the loop thread with m_mutex held, keep it short
+    class Observer {
+      public:
+        virtual ~Observer() {}
+
+        // a command was applied and published, the latency counts from the
+        // oldest submit it coalesced with
+        virtual void
+        on_applied(const std::string& device_id,
+                   std::chrono::steady_clock::duration latency) = 0;
+    };
+
+    // shared by all plugs of the process
+    struct Services {
+        std::shared_ptr<Driver> m_driver;
+        std::shared_ptr<Scheduler> m_scheduler;
+        std::shared_ptr<ScheduleStore> m_schedule_store; // null if not kept
+        std::shared_ptr<Recorder> m_recorder; // null unless recording
+        std::shared_ptr<PowerSampler> m_sampler; // null without telemetry
+        std::shared_ptr<Observer> m_observer;    // null unless measuring
+
+        // applied to each plug loop thread, which drives the relay
+        Realtime::Params m_realtime;
     };
 
     Plug(const Config& config)
         : Device("Plug@" + std::to_string(config.m_gpio_pin)),
-          m_config(config) {}
-    ~Plug() {}
-
-    bool init(const std::shared_ptr<Driver>& driver);
+          m_config(config),
+          m_limiter(config.m_rate_limit, config.m_rate_burst),
+          m_pending(no_command), m_received(0),
+          m_coalesced(0), m_dropped(0), m_applied(0),
+          m_encoding(wire::Encoding::JSON), m_offline(false),
+          m_started(false) {}
+    ~Plug() {
+        if (m_offline_thread.joinable()) {
+            shutdown();
+        }
+    }
+
+    bool init(const Services& services);
     void shutdown();
 
-  private:
-    void loop();
+    // blocks until init has started the client and the loop thread, or
+    // has given up
+    void await_started();
+
+    // runs the plug without a gateway connection, returns once the loop
+    // thread is started. used by the replay harness
+    bool init_offline(const Services& services);
 
+    const std::string& get_device_id() const { return m_config.m_device_id; }
+
+    Stats get_stats() const;
+
+    // delivers a command as the client does, also used to feed a plug
+    // started with init_offline
     void on_command_received(
         std::map<std::string, ::sio::message::ptr>& data) override;
 
+  private:
+    static constexpr uint64_t no_command = 0;
+
+    bool attach_interface(const std::shared_ptr<Driver>& driver);
+    void set_started();
+    hc::api::plug::State initial_state() const;
+
+    bool is_active() const { return m_offline || is_client_running(); }
+
+    void loop();
+
+    void publish_state(const hc::api::plug::State& state);
+    void publish_power();
+
     ::sio::message::ptr serialize_state() const override;
 
-    void handle_power_on(hc::api::plug::State& state);
-    void handle_power_off(hc::api::plug::State& state);
+    void handle_frame(const std::string& bytes);
+    void set_encoding(wire::Encoding encoding);
+
+    void submit_command(hc::api::plug::Command cmd);
+    // does not log, the outcome is returned in message for the caller to
+    // log once it has left the real-time window
+    bool execute_command(hc::api::plug::Command cmd,
+                         hc::api::plug::State& state,
+                         const std::string*& message);
+
+    void handle_set_schedule(std::map<std::string, ::sio::message::ptr>& data);
+    bool apply_schedule(const std::vector<Rule::Spec>& specs);
+
+    bool handle_power_on(hc::api::plug::State& state,
+                         const std::string*& message);
+    bool handle_power_off(hc::api::plug::State& state,
+                          const std::string*& message);
 
     Config m_config;
 
     std::shared_ptr<Driver::HardwareInterface> m_interface;
-
-    std::mutex m_mutex;
-    std::condition_variable m_cv;
+    std::shared_ptr<Scheduler> m_scheduler;
+    std::shared_ptr<ScheduleStore> m_schedule_store;
+    std::shared_ptr<Recorder> m_recorder;
+    std::shared_ptr<PowerSampler> m_sampler;
+    std::shared_ptr<Observer> m_observer;
+    Realtime::Params m_realtime;
+
+    // serialize_state may run on the client thread
+    mutable std::mutex m_power_mutex;
+    std::optional<PowerMeter::Stats> m_power;
+
+    // only touched by the loop thread
+    TokenBucket m_limiter;
+
+    // latest requested command, last writer wins. packed with the steady
+    // clock time of the oldest submit not yet picked up so both change in
+    // one exchange: time_ns << 8 | (command + 1), no_command if none
+    std::atomic<uint64_t> m_pending;
+
+    std::atomic<uint64_t> m_received;
+    std::atomic<uint64_t> m_coalesced;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_applied;
+
+    // guarded by m_mutex, the state last published
+    hc::api::plug::State m_state;
+
+    // read by serialize_state on the client thread. json from every client
+    // start until the gateway sends set_encoding, the client reports no
+    // reconnects so a reconnect keeps the last choice
+    std::atomic<wire::Encoding> m_encoding;
+
+    std::atomic<bool> m_offline;
+    std::thread m_offline_thread;
+
+    std::mutex m_started_mutex;
+    std::condition_variable m_started_cv;
+    bool m_started;
+
+    // the loop thread may run at real-time priority
+    PiMutex m_mutex;
+    PiCondition m_cv;
 };
\ No newline at end of file
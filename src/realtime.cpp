@@ -0,0 +1,204 @@
+#include "realtime.h"
+
+#include <algorithm>
+#include <alloca.h>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <system_error>
+
+namespace {
+
+// well below the low memory stack size
+constexpr size_t prefault_stack_size = 64 * 1024;
+
+// left untouched below the prefaulted range for the frames that follow
+constexpr size_t prefault_stack_margin = 16 * 1024;
+
+} // namespace
+
+thread_local bool Realtime::s_can_raise = true;
+
+bool Realtime::apply_to_current_thread(const Params& params,
+                                       const hc::util::Logger& logger) {
+    if (!params.m_enabled) {
+        return true;
+    }
+
+    bool ok = true;
+
+    sched_param sp = {};
+    sp.sched_priority = params.m_priority;
+
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    s_can_raise = err == 0;
+    if (err != 0) {
+        logger.warn("Failed to set SCHED_FIFO priority " +
+                    std::to_string(params.m_priority) + ": " +
+                    std::strerror(err));
+        ok = false;
+    }
+
+    if (params.m_cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(params.m_cpu, &set);
+
+        err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            logger.warn("Failed to pin thread to CPU " +
+                        std::to_string(params.m_cpu) + ": " +
+                        std::strerror(err));
+            ok = false;
+        }
+    }
+
+    prefault_stack();
+
+    if (ok) {
+        logger.verbose("Real-time scheduling enabled (priority " +
+                       std::to_string(params.m_priority) + ")");
+    }
+
+    return ok;
+}
+
+void Realtime::set_priority(const Params& params, bool realtime) {
+    if (!params.m_enabled || !s_can_raise) {
+        return;
+    }
+
+    sched_param sp = {};
+    sp.sched_priority = realtime ? params.m_priority : 0;
+
+    // a refused raise already warned in apply_to_current_thread. a failed
+    // drop is retried, the thread must not stay real-time
+    int err = pthread_setschedparam(
+        pthread_self(), realtime ? SCHED_FIFO : SCHED_OTHER, &sp);
+    if (err != 0 && realtime) {
+        s_can_raise = false;
+    }
+}
+
+bool Realtime::lock_memory(const hc::util::Logger& logger) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        logger.warn(std::string("Failed to lock memory: ") +
+                    std::strerror(errno));
+        return false;
+    }
+
+    // never give heap back to the system, and serve large allocations from
+    // the already locked heap instead of fresh mappings
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    logger.log("Memory locked");
+    return true;
+}
+
+void Realtime::prefault_stack() {
+    // bounded by the free stack below this frame, small thread stacks from
+    // thread_stack_kb would otherwise overflow
+    size_t size = prefault_stack_size;
+
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        void* stack_addr;
+        size_t stack_size;
+        if (pthread_attr_getstack(&attr, &stack_addr, &stack_size) == 0) {
+            char marker;
+            size_t free = static_cast<size_t>(
+                &marker - static_cast<char*>(stack_addr));
+            size = free > prefault_stack_margin
+                       ? std::min(size, free - prefault_stack_margin)
+                       : 0;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    volatile char* stack = static_cast<volatile char*>(alloca(size));
+    for (size_t i = 0; i < size; i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+PiMutex::PiMutex() {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+
+    int err = pthread_mutex_init(&m_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    if (err != 0) {
+        throw std::system_error(err, std::generic_category(),
+                                "pthread_mutex_init");
+    }
+}
+
+PiMutex::~PiMutex() { pthread_mutex_destroy(&m_mutex); }
+
+void PiMutex::lock() {
+    int err = pthread_mutex_lock(&m_mutex);
+    if (err != 0) {
+        throw std::system_error(err, std::generic_category(),
+                                "pthread_mutex_lock");
+    }
+}
+
+void PiMutex::unlock() { pthread_mutex_unlock(&m_mutex); }
+
+bool PiMutex::try_lock() { return pthread_mutex_trylock(&m_mutex) == 0; }
+
+PiCondition::PiCondition() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    // std::chrono::steady_clock
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+    int err = pthread_cond_init(&m_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (err != 0) {
+        throw std::system_error(err, std::generic_category(),
+                                "pthread_cond_init");
+    }
+}
+
+PiCondition::~PiCondition() { pthread_cond_destroy(&m_cond); }
+
+void PiCondition::wait(std::unique_lock<PiMutex>& lock) {
+    pthread_cond_wait(&m_cond, lock.mutex()->native_handle());
+}
+
+std::cv_status
+PiCondition::wait_until(std::unique_lock<PiMutex>& lock,
+                        std::chrono::steady_clock::time_point deadline) {
+    std::chrono::nanoseconds since_epoch = deadline.time_since_epoch();
+    std::chrono::seconds sec =
+        std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+
+    // also covers a 32-bit time_t that cannot hold the deadline
+    if (deadline == std::chrono::steady_clock::time_point::max() ||
+        sec.count() > std::numeric_limits<time_t>::max()) {
+        wait(lock);
+        return std::cv_status::no_timeout;
+    }
+
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(sec.count());
+    ts.tv_nsec = static_cast<long>((since_epoch - sec).count());
+
+    int err = pthread_cond_timedwait(&m_cond, lock.mutex()->native_handle(),
+                                     &ts);
+    return err == ETIMEDOUT ? std::cv_status::timeout
+                            : std::cv_status::no_timeout;
+}
+
+void PiCondition::notify_one() { pthread_cond_signal(&m_cond); }
+
+void PiCondition::notify_all() { pthread_cond_broadcast(&m_cond); }
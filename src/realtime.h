@@ -0,0 +1,83 @@
+#pragma once
+
+#include <homecontroller/util/logger.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+
+class Realtime {
+  public:
+    struct Params {
+        bool m_enabled = false;
+        int m_priority = 0; // SCHED_FIFO, 1-99
+        int m_cpu = -1;     // -1 leaves the affinity alone
+        bool m_lock_memory = false;
+    };
+
+    // switches the calling thread to SCHED_FIFO and pins it, then touches
+    // its stack so the command path does not page fault later
+    static bool apply_to_current_thread(const Params& params,
+                                        const hc::util::Logger& logger);
+
+    // moves the calling thread between SCHED_FIFO and SCHED_OTHER without
+    // allocating or logging, so it can bracket a short real-time window. a
+    // no-op once raising failed on this thread
+    static void set_priority(const Params& params, bool realtime);
+
+    // locks current and future pages and keeps freed heap mapped, so
+    // allocations on the command path do not fault
+    static bool lock_memory(const hc::util::Logger& logger);
+
+  private:
+    static void prefault_stack();
+
+    // cleared when SCHED_FIFO is refused, later windows skip the syscalls
+    static thread_local bool s_can_raise;
+};
+
+// A mutex with priority inheritance. A real-time thread blocked on it lends
+// its priority to the holder, so a normal thread holding the lock cannot be
+// preempted indefinitely by the load in between. Waited on with PiCondition.
+class PiMutex {
+  public:
+    PiMutex();
+    ~PiMutex();
+
+    PiMutex(const PiMutex&) = delete;
+    PiMutex& operator=(const PiMutex&) = delete;
+
+    void lock();
+    void unlock();
+    bool try_lock();
+
+    pthread_mutex_t* native_handle() { return &m_mutex; }
+
+  private:
+    pthread_mutex_t m_mutex;
+};
+
+// A condition variable for PiMutex. The pthread condition releases and
+// retakes the PiMutex itself, std::condition_variable_any would also take an
+// internal mutex without priority inheritance on every wait and notify.
+class PiCondition {
+  public:
+    PiCondition();
+    ~PiCondition();
+
+    PiCondition(const PiCondition&) = delete;
+    PiCondition& operator=(const PiCondition&) = delete;
+
+    void wait(std::unique_lock<PiMutex>& lock);
+
+    // time_point::max waits without a timeout
+    std::cv_status wait_until(std::unique_lock<PiMutex>& lock,
+                              std::chrono::steady_clock::time_point deadline);
+
+    void notify_one();
+    void notify_all();
+
+  private:
+    pthread_cond_t m_cond;
+};
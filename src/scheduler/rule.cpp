@@ -0,0 +1,353 @@
+#include "rule.h"
+
+#include <homecontroller/util/string.h>
+
+#include <cmath>
+#include <ctime>
+
+namespace {
+
+constexpr double deg_to_rad = M_PI / 180.0;
+constexpr double rad_to_deg = 180.0 / M_PI;
+
+// official zenith for sunrise/sunset, accounts for refraction and sun radius
+constexpr double sun_zenith = 90.833;
+
+// upper bound on cron search steps. parse rejects expressions that can never
+// match, this only guards the search itself
+constexpr int max_cron_steps = 100000;
+
+// february counts its leap day
+constexpr int max_days_in_month[12] = {31, 29, 31, 30, 31, 30,
+                                       31, 31, 30, 31, 30, 31};
+
+double normalize_degrees(double deg) {
+    deg = std::fmod(deg, 360.0);
+    return deg < 0.0 ? deg + 360.0 : deg;
+}
+
+// hours after UTC midnight of the given day at which the sun rises or sets,
+// empty if it does not on that day (polar day/night)
+std::optional<double> sun_event_utc_hours(int day_of_year, bool sunrise,
+                                          const Rule::Location& location) {
+    double lng_hour = location.m_longitude / 15.0;
+    double t = day_of_year + ((sunrise ? 6.0 : 18.0) - lng_hour) / 24.0;
+
+    double mean_anomaly = 0.9856 * t - 3.289;
+    double true_lng = normalize_degrees(
+        mean_anomaly + 1.916 * std::sin(mean_anomaly * deg_to_rad) +
+        0.020 * std::sin(2.0 * mean_anomaly * deg_to_rad) + 282.634);
+
+    double right_asc = normalize_degrees(
+        rad_to_deg * std::atan(0.91764 * std::tan(true_lng * deg_to_rad)));
+    right_asc += std::floor(true_lng / 90.0) * 90.0 -
+                 std::floor(right_asc / 90.0) * 90.0;
+    right_asc /= 15.0;
+
+    double sin_dec = 0.39782 * std::sin(true_lng * deg_to_rad);
+    double cos_dec = std::cos(std::asin(sin_dec));
+
+    double lat_rad = location.m_latitude * deg_to_rad;
+    double cos_hour_angle =
+        (std::cos(sun_zenith * deg_to_rad) - sin_dec * std::sin(lat_rad)) /
+        (cos_dec * std::cos(lat_rad));
+
+    if (cos_hour_angle > 1.0 || cos_hour_angle < -1.0) {
+        return std::nullopt;
+    }
+
+    double hour_angle = rad_to_deg * std::acos(cos_hour_angle);
+    if (sunrise) {
+        hour_angle = 360.0 - hour_angle;
+    }
+    hour_angle /= 15.0;
+
+    double local_mean = hour_angle + right_asc - 0.06571 * t - 6.622;
+    double utc = std::fmod(local_mean - lng_hour, 24.0);
+
+    return utc < 0.0 ? utc + 24.0 : utc;
+}
+
+// re-normalizes broken down local time after a field was incremented
+void normalize_tm(std::tm& tm) {
+    tm.tm_isdst = -1;
+    std::time_t t = std::mktime(&tm);
+    localtime_r(&t, &tm);
+}
+
+} // namespace
+
+Result<Rule> Rule::parse(const Spec& spec,
+                         const std::optional<Location>& location) {
+    Rule rule;
+
+    Result<hc::api::plug::Command> cmd_res =
+        hc::api::plug::string_to_command(spec.m_command);
+    if (!cmd_res.is_ok()) {
+        return Result<Rule>::Err(Error(__func__, cmd_res));
+    }
+
+    rule.m_command = cmd_res.unwrap();
+
+    if (!spec.m_cron.empty() && !spec.m_sun.empty()) {
+        return Result<Rule>::Err(
+            Error(__func__, "rule cannot have both \"cron\" and \"sun\""));
+    }
+
+    if (!spec.m_sun.empty()) {
+        if (!location) {
+            return Result<Rule>::Err(Error(
+                __func__, "sun rule needs a top-level \"location\""));
+        }
+
+        rule.m_type = Type::SUN;
+        rule.m_offset = spec.m_offset;
+
+        if (spec.m_sun == "sunrise") {
+            rule.m_sun_event = SunEvent::SUNRISE;
+        } else if (spec.m_sun == "sunset") {
+            rule.m_sun_event = SunEvent::SUNSET;
+        } else {
+            return Result<Rule>::Err(
+                Error(__func__, "invalid sun event \"" + spec.m_sun + "\""));
+        }
+
+        return Result<Rule>::Ok(rule);
+    }
+
+    if (spec.m_cron.empty()) {
+        return Result<Rule>::Err(
+            Error(__func__, "rule needs either \"cron\" or \"sun\""));
+    }
+
+    rule.m_type = Type::CRON;
+
+    std::vector<std::string> fields;
+    for (const std::string& f : hc::util::str::split(spec.m_cron, ' ')) {
+        if (!f.empty()) {
+            fields.push_back(f);
+        }
+    }
+
+    if (fields.size() != 5) {
+        return Result<Rule>::Err(Error(
+            __func__, "cron expression \"" + spec.m_cron +
+                          "\" must have 5 fields (min hour dom month dow)"));
+    }
+
+    struct FieldDesc {
+        std::bitset<64>& m_bits;
+        int m_min;
+        int m_max;
+    };
+
+    FieldDesc descs[] = {{rule.m_minutes, 0, 59},
+                         {rule.m_hours, 0, 23},
+                         {rule.m_days_of_month, 1, 31},
+                         {rule.m_months, 1, 12},
+                         {rule.m_days_of_week, 0, 7}};
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        Result<> field_res = parse_cron_field(fields[i], descs[i].m_min,
+                                              descs[i].m_max, descs[i].m_bits);
+        if (!field_res.is_ok()) {
+            return Result<Rule>::Err(Error(__func__, field_res));
+        }
+    }
+
+    // both 0 and 7 mean sunday
+    if (rule.m_days_of_week.test(7)) {
+        rule.m_days_of_week.set(0);
+    }
+
+    rule.m_dom_wildcard = fields[2] == "*";
+    rule.m_dow_wildcard = fields[4] == "*";
+
+    // a day of month restricted on its own has to exist in one of the
+    // months, every day of the week does
+    if (!rule.m_dom_wildcard && rule.m_dow_wildcard) {
+        bool possible = false;
+        for (int month = 1; month <= 12 && !possible; month++) {
+            if (!rule.m_months.test(month)) {
+                continue;
+            }
+
+            for (int day = 1; day <= max_days_in_month[month - 1]; day++) {
+                if (rule.m_days_of_month.test(day)) {
+                    possible = true;
+                    break;
+                }
+            }
+        }
+
+        if (!possible) {
+            return Result<Rule>::Err(Error(
+                __func__, "cron expression \"" + spec.m_cron +
+                              "\" never fires"));
+        }
+    }
+
+    return Result<Rule>::Ok(rule);
+}
+
+std::optional<Rule::Clock::time_point>
+Rule::next_fire(const Clock::time_point& after,
+                const std::optional<Location>& location) const {
+    switch (m_type) {
+    case Type::CRON:
+        return next_cron_fire(after);
+    case Type::SUN:
+        if (!location) {
+            return std::nullopt;
+        }
+        return next_sun_fire(after, *location);
+    }
+
+    return std::nullopt;
+}
+
+Result<> Rule::parse_cron_field(const std::string& field, int min, int max,
+                                std::bitset<64>& res) {
+    for (const std::string& part : hc::util::str::split(field, ',')) {
+        std::vector<std::string> range_step = hc::util::str::split(part, '/');
+        if (range_step.empty() || range_step.size() > 2) {
+            return Result<>::Err(
+                Error(__func__, "invalid cron field \"" + field + "\""));
+        }
+
+        int lo = min;
+        int hi = max;
+        int step = 1;
+
+        try {
+            if (range_step.size() == 2) {
+                step = std::stoi(range_step[1]);
+            }
+
+            const std::string& range = range_step[0];
+            if (range != "*") {
+                std::vector<std::string> bounds =
+                    hc::util::str::split(range, '-');
+                if (bounds.empty() || bounds.size() > 2) {
+                    return Result<>::Err(Error(
+                        __func__, "invalid cron range \"" + range + "\""));
+                }
+
+                lo = std::stoi(bounds[0]);
+                hi = bounds.size() == 2 ? std::stoi(bounds[1])
+                                        : (range_step.size() == 2 ? max : lo);
+            }
+        } catch (const std::exception&) {
+            return Result<>::Err(
+                Error(__func__, "invalid cron field \"" + field + "\""));
+        }
+
+        if (lo < min || hi > max || lo > hi || step < 1) {
+            return Result<>::Err(
+                Error(__func__, "cron field \"" + field + "\" out of range"));
+        }
+
+        for (int v = lo; v <= hi; v += step) {
+            res.set(v);
+        }
+    }
+
+    return Result<>::Ok(None{});
+}
+
+std::optional<Rule::Clock::time_point>
+Rule::next_cron_fire(const Clock::time_point& after) const {
+    // start at the beginning of the next minute
+    std::time_t t = Clock::to_time_t(after);
+    t = t - (t % 60) + 60;
+
+    std::tm tm;
+    localtime_r(&t, &tm);
+
+    for (int i = 0; i < max_cron_steps; i++) {
+        if (!m_months.test(tm.tm_mon + 1)) {
+            tm.tm_mon++;
+            tm.tm_mday = 1;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+            normalize_tm(tm);
+            continue;
+        }
+
+        // standard cron semantics: if both day fields are restricted, either
+        // one matching is enough
+        bool dom_match = m_days_of_month.test(tm.tm_mday);
+        bool dow_match = m_days_of_week.test(tm.tm_wday);
+        bool day_match;
+        if (m_dom_wildcard || m_dow_wildcard) {
+            day_match = dom_match && dow_match;
+        } else {
+            day_match = dom_match || dow_match;
+        }
+
+        if (!day_match) {
+            tm.tm_mday++;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+            normalize_tm(tm);
+            continue;
+        }
+
+        if (!m_hours.test(tm.tm_hour)) {
+            tm.tm_hour++;
+            tm.tm_min = 0;
+            normalize_tm(tm);
+            continue;
+        }
+
+        if (!m_minutes.test(tm.tm_min)) {
+            tm.tm_min++;
+            normalize_tm(tm);
+            continue;
+        }
+
+        tm.tm_isdst = -1;
+        return Clock::from_time_t(std::mktime(&tm));
+    }
+
+    return std::nullopt;
+}
+
+std::optional<Rule::Clock::time_point>
+Rule::next_sun_fire(const Clock::time_point& after,
+                    const Location& location) const {
+    std::time_t t = Clock::to_time_t(after);
+
+    std::tm day;
+    gmtime_r(&t, &day);
+    day.tm_hour = 0;
+    day.tm_min = 0;
+    day.tm_sec = 0;
+
+    // start one day early, an event on the previous UTC day can still lie in
+    // the future once the offset is applied
+    day.tm_mday--;
+
+    // a year covers the longest polar night
+    for (int i = 0; i < 367; i++, day.tm_mday++) {
+        std::time_t midnight = timegm(&day);
+        gmtime_r(&midnight, &day);
+
+        std::optional<double> hours = sun_event_utc_hours(
+            day.tm_yday + 1, m_sun_event == SunEvent::SUNRISE, location);
+        if (!hours) {
+            continue;
+        }
+
+        Clock::time_point fire =
+            Clock::from_time_t(midnight) +
+            std::chrono::seconds(static_cast<long>(*hours * 3600.0)) +
+            std::chrono::minutes(m_offset);
+
+        if (fire > after) {
+            return fire;
+        }
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <homecontroller/api/device_data/plug.h>
+#include <homecontroller/util/result.h>
+
+#include <bitset>
+#include <chrono>
+#include <optional>
+#include <string>
+
+class Rule {
+  public:
+    using Clock = std::chrono::system_clock;
+
+    enum class Type { CRON, SUN };
+    enum class SunEvent { SUNRISE, SUNSET };
+
+    // unparsed rule, as read from the config or a set_schedule command
+    struct Spec {
+        std::string m_cron;
+        std::string m_sun;
+        int m_offset = 0;
+        std::string m_command;
+    };
+
+    struct Location {
+        double m_latitude = 0.0;
+        double m_longitude = 0.0;
+    };
+
+    Rule()
+        : m_type(Type::CRON), m_command(hc::api::plug::Command::PowerOff),
+          m_dom_wildcard(true), m_dow_wildcard(true),
+          m_sun_event(SunEvent::SUNRISE), m_offset(0) {}
+    ~Rule() {}
+
+    // rejects rules that can never fire, sun rules need the location
+    static Result<Rule> parse(const Spec& spec,
+                              const std::optional<Location>& location);
+
+    std::optional<Clock::time_point>
+    next_fire(const Clock::time_point& after,
+              const std::optional<Location>& location) const;
+
+    Type get_type() const { return m_type; }
+    hc::api::plug::Command get_command() const { return m_command; }
+
+  private:
+    static Result<> parse_cron_field(const std::string& field, int min,
+                                     int max, std::bitset<64>& res);
+
+    std::optional<Clock::time_point>
+    next_cron_fire(const Clock::time_point& after) const;
+    std::optional<Clock::time_point>
+    next_sun_fire(const Clock::time_point& after,
+                  const Location& location) const;
+
+    Type m_type;
+    hc::api::plug::Command m_command;
+
+    // cron fields, bit n set if value n matches
+    std::bitset<64> m_minutes;
+    std::bitset<64> m_hours;
+    std::bitset<64> m_days_of_month;
+    std::bitset<64> m_months;
+    std::bitset<64> m_days_of_week;
+    bool m_dom_wildcard;
+    bool m_dow_wildcard;
+
+    // sun fields
+    SunEvent m_sun_event;
+    int m_offset;
+};
@@ -0,0 +1,155 @@
+#include "schedule_store.h"
+
+#include <rapidjson/document.h>
+#include <rapidjson/error/en.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Result<std::optional<std::vector<Rule::Spec>>>
+ScheduleStore::load(const std::string& device_id) const {
+    Result<std::string> path_res = path_for(device_id);
+    if (!path_res.is_ok()) {
+        return Result<std::optional<std::vector<Rule::Spec>>>::Err(
+            Error(__func__, path_res));
+    }
+
+    std::string path = path_res.unwrap();
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 && errno == ENOENT) {
+        return Result<std::optional<std::vector<Rule::Spec>>>::Ok(std::nullopt);
+    }
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.good()) {
+        return Result<std::optional<std::vector<Rule::Spec>>>::Err(
+            Error(__func__, "failed to open file \"" + path + "\""));
+    }
+
+    std::string buf(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(buf.data(), buf.size());
+    file.close();
+
+    rapidjson::Document doc;
+    rapidjson::ParseResult res = doc.Parse(buf.data(), buf.size());
+    if (!res) {
+        std::string err_str =
+            std::string(rapidjson::GetParseError_En(res.Code()));
+        return Result<std::optional<std::vector<Rule::Spec>>>::Err(
+            Error(__func__, err_str));
+    }
+
+    if (!doc.IsObject() || !doc.HasMember("schedule") ||
+        !doc["schedule"].IsArray()) {
+        return Result<std::optional<std::vector<Rule::Spec>>>::Err(
+            Error(__func__, "missing \"schedule\" array"));
+    }
+
+    // validated by Rule::parse once applied
+    std::vector<Rule::Spec> specs;
+    for (const auto& rule_doc : doc["schedule"].GetArray()) {
+        if (!rule_doc.IsObject() || !rule_doc.HasMember("command") ||
+            !rule_doc["command"].IsString()) {
+            return Result<std::optional<std::vector<Rule::Spec>>>::Err(
+                Error(__func__, "invalid rule"));
+        }
+
+        Rule::Spec spec;
+        spec.m_command = rule_doc["command"].GetString();
+
+        if (rule_doc.HasMember("cron") && rule_doc["cron"].IsString()) {
+            spec.m_cron = rule_doc["cron"].GetString();
+        }
+
+        if (rule_doc.HasMember("sun") && rule_doc["sun"].IsString()) {
+            spec.m_sun = rule_doc["sun"].GetString();
+        }
+
+        if (rule_doc.HasMember("offset") && rule_doc["offset"].IsInt()) {
+            spec.m_offset = rule_doc["offset"].GetInt();
+        }
+
+        specs.push_back(spec);
+    }
+
+    return Result<std::optional<std::vector<Rule::Spec>>>::Ok(specs);
+}
+
+Result<> ScheduleStore::save(const std::string& device_id,
+                             const std::vector<Rule::Spec>& specs) const {
+    Result<std::string> path_res = path_for(device_id);
+    if (!path_res.is_ok()) {
+        return Result<>::Err(Error(__func__, path_res));
+    }
+
+    std::string path = path_res.unwrap();
+    std::string tmp_path = path + ".tmp";
+
+    rapidjson::StringBuffer buf;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
+
+    writer.StartObject();
+    writer.Key("schedule");
+    writer.StartArray();
+    for (const Rule::Spec& spec : specs) {
+        writer.StartObject();
+        writer.Key("command");
+        writer.String(spec.m_command.c_str());
+        if (!spec.m_cron.empty()) {
+            writer.Key("cron");
+            writer.String(spec.m_cron.c_str());
+        }
+        if (!spec.m_sun.empty()) {
+            writer.Key("sun");
+            writer.String(spec.m_sun.c_str());
+            writer.Key("offset");
+            writer.Int(spec.m_offset);
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    std::FILE* file = std::fopen(tmp_path.c_str(), "wb");
+    if (!file) {
+        return Result<>::Err(Error(__func__, "failed to open file \"" +
+                                                 tmp_path + "\": " +
+                                                 std::strerror(errno)));
+    }
+
+    // synced before the rename, or a crash could leave an empty file behind
+    bool ok = std::fwrite(buf.GetString(), 1, buf.GetSize(), file) ==
+                  buf.GetSize() &&
+              std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = std::fclose(file) == 0 && ok;
+
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::string err = std::strerror(errno);
+        std::remove(tmp_path.c_str());
+        return Result<>::Err(Error(
+            __func__, "failed to write file \"" + path + "\": " + err));
+    }
+
+    return Result<>::Ok(None{});
+}
+
+Result<std::string>
+ScheduleStore::path_for(const std::string& device_id) const {
+    // the id names the file, it must not lead out of the directory
+    if (device_id.empty() || device_id[0] == '.' ||
+        device_id.find('/') != std::string::npos) {
+        return Result<std::string>::Err(
+            Error(__func__, "device id \"" + device_id +
+                                "\" cannot name a schedule file"));
+    }
+
+    return Result<std::string>::Ok(m_dir + "/" + device_id + ".json");
+}
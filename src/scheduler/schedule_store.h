@@ -0,0 +1,31 @@
+#pragma once
+
+#include "rule.h"
+
+#include <homecontroller/util/result.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// Keeps the schedule last set by the gateway in one file per device, in the
+// format of a plug's "schedule" config array, so it survives a restart. A
+// save is written next to the file and renamed over it, a crash leaves the
+// old or the new schedule.
+class ScheduleStore {
+  public:
+    ScheduleStore(const std::string& dir) : m_dir(dir) {}
+    ~ScheduleStore() {}
+
+    // empty if nothing was stored for the device
+    Result<std::optional<std::vector<Rule::Spec>>>
+    load(const std::string& device_id) const;
+
+    Result<> save(const std::string& device_id,
+                  const std::vector<Rule::Spec>& specs) const;
+
+  private:
+    Result<std::string> path_for(const std::string& device_id) const;
+
+    std::string m_dir;
+};
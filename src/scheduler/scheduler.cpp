@@ -0,0 +1,155 @@
+#include "scheduler.h"
+
+#include "../watchdog/heartbeat.h"
+
+#include <algorithm>
+
+namespace {
+
+// the resolution of a cron rule
+constexpr std::chrono::minutes max_rule_wait(1);
+
+} // namespace
+
+bool Scheduler::start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_running) {
+        m_logger.error("start(): Already running!");
+        return false;
+    }
+
+    m_running = true;
+    m_thread = std::thread(&Scheduler::loop, this);
+
+    m_logger.log("Started!");
+    return true;
+}
+
+void Scheduler::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+
+        m_running = false;
+        m_cv.notify_all();
+    }
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    m_logger.log("Stopped");
+}
+
+void Scheduler::set_rules(const std::string& device_id,
+                          const std::vector<Rule>& rules,
+                          const Callback& callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    DeviceRules& dev = m_devices[device_id];
+    dev.m_rules = rules;
+    dev.m_callback = callback;
+    dev.m_generation = m_next_generation++;
+
+    Rule::Clock::time_point now = Rule::Clock::now();
+    for (size_t i = 0; i < dev.m_rules.size(); i++) {
+        enqueue_next(device_id, dev, i, now);
+    }
+
+    m_logger.verbose("set_rules(): " + std::to_string(rules.size()) +
+                     " rule(s) for " + device_id);
+
+    // the earliest fire time may have changed
+    m_cv.notify_all();
+}
+
+void Scheduler::remove(const std::string& device_id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // queued entries are discarded lazily once they reach the top
+    m_devices.erase(device_id);
+}
+
+void Scheduler::loop() {
+    Heartbeat heartbeat("scheduler");
+    heartbeat.beat("acquire", "Scheduler::m_mutex");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    std::vector<std::pair<Callback, hc::api::plug::Command>> due;
+
+    while (m_running) {
+        heartbeat.beat("wait_rule", "Scheduler::m_mutex");
+
+        // set_rules and shutdown notify under the lock, a wake is never
+        // missed between checking the queue and waiting
+        if (m_queue.empty()) {
+            heartbeat.idle(Heartbeat::Clock::time_point::max());
+            m_cv.wait(lock);
+            continue;
+        }
+
+        Rule::Clock::time_point now = Rule::Clock::now();
+        Rule::Clock::time_point next = m_queue.top().m_time;
+        if (now < next) {
+            // waited on the steady clock, a wall clock step is picked up
+            // within max_rule_wait
+            Heartbeat::Clock::time_point wake =
+                Heartbeat::Clock::now() +
+                std::chrono::duration_cast<Heartbeat::Clock::duration>(
+                    std::min<Rule::Clock::duration>(next - now,
+                                                    max_rule_wait));
+            heartbeat.idle(wake);
+            m_cv.wait_until(lock, wake);
+            continue;
+        }
+
+        heartbeat.beat("collect_due");
+
+        now = Rule::Clock::now();
+        while (!m_queue.empty() && m_queue.top().m_time <= now) {
+            Entry entry = m_queue.top();
+            m_queue.pop();
+
+            auto mit = m_devices.find(entry.m_device_id);
+            if (mit == m_devices.end() ||
+                mit->second.m_generation != entry.m_generation) {
+                continue;
+            }
+
+            const DeviceRules& dev = mit->second;
+            due.emplace_back(dev.m_callback,
+                             dev.m_rules[entry.m_rule_idx].get_command());
+
+            // fire at most once per due time, even if we woke up late
+            enqueue_next(entry.m_device_id, dev, entry.m_rule_idx, now);
+        }
+
+        // callbacks lock the plug, never hold our lock while calling them
+        lock.unlock();
+        heartbeat.beat("fire_callbacks");
+        for (const auto& [callback, command] : due) {
+            callback(command);
+        }
+        due.clear();
+        heartbeat.beat("acquire", "Scheduler::m_mutex");
+        lock.lock();
+    }
+}
+
+void Scheduler::enqueue_next(const std::string& device_id,
+                             const DeviceRules& dev, size_t rule_idx,
+                             const Rule::Clock::time_point& after) {
+    std::optional<Rule::Clock::time_point> next =
+        dev.m_rules[rule_idx].next_fire(after, m_location);
+    if (!next) {
+        m_logger.warn("Rule " + std::to_string(rule_idx) + " of " + device_id +
+                      " never fires");
+        return;
+    }
+
+    m_queue.push({*next, device_id, rule_idx, dev.m_generation});
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "rule.h"
+
+#include <homecontroller/util/logger.h>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Evaluates the schedule rules of every plug on-device. All rules share one
+// queue ordered by next fire time, so the thread only wakes when the earliest
+// rule is due.
+class Scheduler {
+  public:
+    using Callback = std::function<void(hc::api::plug::Command)>;
+
+    Scheduler(const std::optional<Rule::Location>& location)
+        : m_logger("Scheduler"), m_location(location), m_running(false) {}
+    ~Scheduler() { shutdown(); }
+
+    bool start();
+    void shutdown();
+
+    // replaces all rules of a device, pending fires of old rules are dropped
+    void set_rules(const std::string& device_id, const std::vector<Rule>& rules,
+                   const Callback& callback);
+    void remove(const std::string& device_id);
+
+    // fixed at construction, rules are parsed against it
+    const std::optional<Rule::Location>& get_location() const {
+        return m_location;
+    }
+
+  private:
+    struct Entry {
+        Rule::Clock::time_point m_time;
+        std::string m_device_id;
+        size_t m_rule_idx;
+        uint64_t m_generation;
+
+        bool operator>(const Entry& other) const {
+            return m_time > other.m_time;
+        }
+    };
+
+    struct DeviceRules {
+        std::vector<Rule> m_rules;
+        Callback m_callback;
+        uint64_t m_generation;
+    };
+
+    void loop();
+
+    void enqueue_next(const std::string& device_id, const DeviceRules& dev,
+                      size_t rule_idx, const Rule::Clock::time_point& after);
+
+    hc::util::Logger m_logger;
+
+    std::optional<Rule::Location> m_location;
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>
+        m_queue;
+    std::map<std::string, DeviceRules> m_devices;
+    uint64_t m_next_generation = 0;
+
+    bool m_running;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
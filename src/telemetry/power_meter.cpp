@@ -0,0 +1,140 @@
+#include "power_meter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// centering the 12-bit samples first keeps the float variance precise
+constexpr float adc_mid_scale = 2048.0f;
+
+// AC RMS of one channel, the DC offset of the sensor is removed by using the
+// variance instead of the raw mean square. GCC does not vectorize a float
+// reduction at -O2, so targets with SIMD (NEON, SSE2) sum four lanes
+// explicitly. The Pi Zero's ARMv6 has none and takes the scalar loop.
+float ac_rms(const float* __restrict samples, size_t count) {
+    float sum = 0.0f;
+    float sum_sq = 0.0f;
+    size_t i = 0;
+
+#if defined(__ARM_NEON) || defined(__SSE2__)
+    typedef float v4sf __attribute__((vector_size(16)));
+
+    v4sf vsum = {0.0f, 0.0f, 0.0f, 0.0f};
+    v4sf vsum_sq = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (; i + 4 <= count; i += 4) {
+        v4sf v;
+        std::memcpy(&v, samples + i, sizeof(v));
+        vsum += v;
+        vsum_sq += v * v;
+    }
+
+    sum = vsum[0] + vsum[1] + vsum[2] + vsum[3];
+    sum_sq = vsum_sq[0] + vsum_sq[1] + vsum_sq[2] + vsum_sq[3];
+#endif
+
+    for (; i < count; i++) {
+        sum += samples[i];
+        sum_sq += samples[i] * samples[i];
+    }
+
+    float mean = sum / count;
+    float variance = sum_sq / count - mean * mean;
+
+    return variance > 0.0f ? std::sqrt(variance) : 0.0f;
+}
+
+} // namespace
+
+PowerMeter::PowerMeter(const Params& params)
+    : m_params(params),
+      m_window_samples(std::max<size_t>(
+          1, static_cast<size_t>(params.m_sample_rate) * params.m_window_ms /
+                 1000)),
+      m_window(m_window_samples * params.m_channels), m_fill(0),
+      m_accumulators(params.m_channels) {
+    for (Accumulator& acc : m_accumulators) {
+        reset_window(acc);
+        acc.m_energy_kwh = 0.0;
+    }
+}
+
+void PowerMeter::add_frames(const uint16_t* frames, size_t frame_count) {
+    const unsigned int channels = m_params.m_channels;
+
+    while (frame_count > 0) {
+        size_t n = std::min(frame_count, m_window_samples - m_fill);
+
+        // deinterleave into the per-channel runs
+        for (unsigned int c = 0; c < channels; c++) {
+            float* __restrict dst = m_window.data() + c * m_window_samples;
+            for (size_t i = 0; i < n; i++) {
+                dst[m_fill + i] = frames[i * channels + c] - adc_mid_scale;
+            }
+        }
+
+        m_fill += n;
+        frames += n * channels;
+        frame_count -= n;
+
+        if (m_fill == m_window_samples) {
+            close_window();
+            m_fill = 0;
+        }
+    }
+}
+
+PowerMeter::Stats PowerMeter::take_stats(unsigned int channel) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats = {};
+    if (channel >= m_accumulators.size()) {
+        return stats;
+    }
+
+    Accumulator& acc = m_accumulators[channel];
+    stats.m_windows = acc.m_windows;
+    stats.m_energy_kwh = acc.m_energy_kwh;
+
+    if (acc.m_windows > 0) {
+        stats.m_min_w = acc.m_min_w;
+        stats.m_max_w = acc.m_max_w;
+        stats.m_mean_w = acc.m_sum_w / acc.m_windows;
+    }
+
+    reset_window(acc);
+    return stats;
+}
+
+void PowerMeter::reset_window(Accumulator& acc) {
+    acc.m_min_w = std::numeric_limits<double>::max();
+    acc.m_max_w = 0.0;
+    acc.m_sum_w = 0.0;
+    acc.m_windows = 0;
+}
+
+void PowerMeter::close_window() {
+    double window_hours = static_cast<double>(m_window_samples) /
+                          m_params.m_sample_rate / 3600.0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (unsigned int c = 0; c < m_params.m_channels; c++) {
+        float rms_counts =
+            ac_rms(m_window.data() + c * m_window_samples, m_window_samples);
+
+        // apparent power, there is no voltage sensing
+        double watts = rms_counts * m_params.m_amps_per_count *
+                       m_params.m_voltage;
+
+        Accumulator& acc = m_accumulators[c];
+        acc.m_min_w = std::min(acc.m_min_w, watts);
+        acc.m_max_w = std::max(acc.m_max_w, watts);
+        acc.m_sum_w += watts;
+        acc.m_windows++;
+        acc.m_energy_kwh += watts * window_hours / 1000.0;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Turns raw current samples into windowed power figures. Windows are closed
+// by the aggregation thread, stats are taken by the plugs.
+class PowerMeter {
+  public:
+    struct Params {
+        unsigned int m_channels;
+        unsigned int m_sample_rate;
+        unsigned int m_window_ms;
+        double m_voltage;
+        double m_amps_per_count;
+    };
+
+    // power in watts over the windows since the last take_stats
+    struct Stats {
+        double m_min_w;
+        double m_mean_w;
+        double m_max_w;
+        double m_energy_kwh; // since start
+        uint64_t m_windows;
+    };
+
+    PowerMeter(const Params& params);
+    ~PowerMeter() {}
+
+    // frames are interleaved, one sample per channel each
+    void add_frames(const uint16_t* frames, size_t frame_count);
+
+    Stats take_stats(unsigned int channel);
+
+    size_t get_window_samples() const { return m_window_samples; }
+
+  private:
+    struct Accumulator {
+        double m_min_w;
+        double m_max_w;
+        double m_sum_w;
+        uint64_t m_windows;
+        double m_energy_kwh;
+    };
+
+    static void reset_window(Accumulator& acc);
+
+    void close_window();
+
+    Params m_params;
+    size_t m_window_samples;
+
+    // channel-major so each channel is one contiguous run for the RMS loop
+    std::vector<float> m_window;
+    size_t m_fill;
+
+    std::vector<Accumulator> m_accumulators;
+    std::mutex m_mutex;
+};
@@ -0,0 +1,131 @@
+#include "power_sampler.h"
+
+#include "../watchdog/heartbeat.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// ring holds this much signal before the sampler starts dropping frames
+constexpr unsigned int ring_ms = 500;
+
+// the aggregator drains the ring this many times per window
+constexpr unsigned int drains_per_window = 4;
+
+// resync instead of bursting if the sampler falls this many periods behind
+constexpr int max_lag_periods = 100;
+
+} // namespace
+
+PowerSampler::PowerSampler(const Params& params,
+                           const std::shared_ptr<Driver>& driver)
+    : m_logger("PowerSampler"), m_params(params), m_driver(driver),
+      m_ring(static_cast<size_t>(params.m_adc.m_sample_rate) * ring_ms /
+                 1000 * params.m_adc.m_channels +
+             params.m_adc.m_channels),
+      m_meter(params.m_meter), m_running(false), m_overruns(0),
+      m_read_errors(0) {}
+
+bool PowerSampler::start() {
+    if (m_running) {
+        m_logger.error("start(): Already running!");
+        return false;
+    }
+
+    if (!m_driver->open_adc(m_params.m_adc)) {
+        m_logger.error("start(): Failed to open ADC");
+        return false;
+    }
+
+    m_running = true;
+    m_sample_thread = std::thread(&PowerSampler::sample_loop, this);
+    m_aggregate_thread = std::thread(&PowerSampler::aggregate_loop, this);
+
+    m_logger.log("Sampling " + std::to_string(m_params.m_adc.m_channels) +
+                 " channel(s) at " +
+                 std::to_string(m_params.m_adc.m_sample_rate) + " Hz");
+    return true;
+}
+
+void PowerSampler::shutdown() {
+    if (!m_running) {
+        return;
+    }
+
+    m_running = false;
+
+    if (m_sample_thread.joinable()) {
+        m_sample_thread.join();
+    }
+
+    if (m_aggregate_thread.joinable()) {
+        m_aggregate_thread.join();
+    }
+
+    m_driver->close_adc();
+
+    if (m_overruns > 0 || m_read_errors > 0) {
+        m_logger.warn("Dropped frames: " + std::to_string(m_overruns) +
+                      " overrun(s), " + std::to_string(m_read_errors) +
+                      " read error(s)");
+    }
+
+    m_logger.log("Stopped");
+}
+
+void PowerSampler::sample_loop() {
+    std::vector<uint16_t> frame(m_params.m_adc.m_channels);
+
+    const std::chrono::nanoseconds period(1000000000ull /
+                                          m_params.m_adc.m_sample_rate);
+    std::chrono::steady_clock::time_point next =
+        std::chrono::steady_clock::now();
+
+    Heartbeat heartbeat("sampler");
+
+    while (m_running) {
+        heartbeat.beat("read_adc");
+        if (!m_driver->read_adc(frame.data())) {
+            m_read_errors++;
+        } else if (!m_ring.push(frame.data(), frame.size())) {
+            m_overruns++;
+        }
+
+        next += period;
+
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        if (next > now) {
+            heartbeat.beat("sleep");
+            heartbeat.idle(next);
+            std::this_thread::sleep_until(next);
+        } else if (now - next > period * max_lag_periods) {
+            next = now;
+        }
+    }
+}
+
+void PowerSampler::aggregate_loop() {
+    const size_t channels = m_params.m_adc.m_channels;
+
+    // whole frames only, the producer pushes one frame at a time
+    std::vector<uint16_t> block(m_meter.get_window_samples() * channels);
+
+    const std::chrono::milliseconds drain_interval(std::max(
+        1u, m_params.m_meter.m_window_ms / drains_per_window));
+
+    Heartbeat heartbeat("aggregator");
+
+    while (m_running) {
+        heartbeat.beat("sleep");
+        heartbeat.idle(std::chrono::steady_clock::now() + drain_interval);
+        std::this_thread::sleep_for(drain_interval);
+
+        heartbeat.beat("aggregate");
+        size_t count;
+        while ((count = m_ring.pop(block.data(), block.size())) > 0) {
+            m_meter.add_frames(block.data(), count / channels);
+        }
+    }
+}
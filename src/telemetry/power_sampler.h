@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../driver/driver.h"
+#include "power_meter.h"
+#include "ring_buffer.h"
+
+#include <atomic>
+#include <thread>
+
+// Reads the current-sense ADC at the sample rate on one thread and feeds a
+// second thread through a lock-free ring, which turns the samples into
+// windowed power figures.
+class PowerSampler {
+  public:
+    struct Params {
+        Driver::AdcParams m_adc;
+        PowerMeter::Params m_meter;
+        unsigned int m_publish_ms;
+    };
+
+    PowerSampler(const Params& params, const std::shared_ptr<Driver>& driver);
+    ~PowerSampler() { shutdown(); }
+
+    bool start();
+    void shutdown();
+
+    PowerMeter::Stats take_stats(unsigned int channel) {
+        return m_meter.take_stats(channel);
+    }
+
+    unsigned int get_publish_ms() const { return m_params.m_publish_ms; }
+
+  private:
+    void sample_loop();
+    void aggregate_loop();
+
+    hc::util::Logger m_logger;
+
+    Params m_params;
+    std::shared_ptr<Driver> m_driver;
+
+    RingBuffer<uint16_t> m_ring;
+    PowerMeter m_meter;
+
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_overruns;
+    std::atomic<uint64_t> m_read_errors;
+
+    std::thread m_sample_thread;
+    std::thread m_aggregate_thread;
+};
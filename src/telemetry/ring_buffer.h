@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free single producer, single consumer ring buffer. The capacity is
+// rounded up to a power of two.
+template <typename T> class RingBuffer {
+  public:
+    RingBuffer(size_t capacity) : m_head(0), m_tail(0) {
+        size_t pow2 = 1;
+        while (pow2 < capacity) {
+            pow2 <<= 1;
+        }
+
+        m_buffer.resize(pow2);
+        m_mask = pow2 - 1;
+    }
+    ~RingBuffer() {}
+
+    // all or nothing, false if there is not enough space
+    bool push(const T* items, size_t count) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+
+        if (m_buffer.size() - (head - tail) < count) {
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            m_buffer[(head + i) & m_mask] = items[i];
+        }
+
+        m_head.store(head + count, std::memory_order_release);
+        return true;
+    }
+
+    // pops up to max_count items, returns the number popped
+    size_t pop(T* items, size_t max_count) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+
+        size_t count = head - tail;
+        if (count > max_count) {
+            count = max_count;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            items[i] = m_buffer[(tail + i) & m_mask];
+        }
+
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t get_capacity() const { return m_buffer.size(); }
+
+  private:
+    std::vector<T> m_buffer;
+    size_t m_mask;
+
+    // on separate cache lines, each index is written by one thread only
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+};
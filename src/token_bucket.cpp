@@ -0,0 +1,36 @@
+#include "token_bucket.h"
+
+TokenBucket::Clock::duration TokenBucket::time_until_token() {
+    if (m_rate <= 0.0) {
+        return Clock::duration::zero();
+    }
+
+    refill();
+
+    if (m_tokens >= 1.0) {
+        return Clock::duration::zero();
+    }
+
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>((1.0 - m_tokens) / m_rate));
+}
+
+void TokenBucket::consume() {
+    if (m_rate <= 0.0) {
+        return;
+    }
+
+    refill();
+    m_tokens -= 1.0;
+}
+
+void TokenBucket::refill() {
+    Clock::time_point now = Clock::now();
+    std::chrono::duration<double> elapsed = now - m_last_refill;
+    m_last_refill = now;
+
+    m_tokens += elapsed.count() * m_rate;
+    if (m_tokens > m_burst) {
+        m_tokens = m_burst;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+
+// Classic token bucket. Not thread safe, the owner serializes access.
+class TokenBucket {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // a rate of 0 disables limiting
+    TokenBucket(double rate, double burst)
+        : m_rate(rate), m_burst(burst < 1.0 ? 1.0 : burst), m_tokens(m_burst),
+          m_last_refill(Clock::now()) {}
+    ~TokenBucket() {}
+
+    // zero if a token is available now
+    Clock::duration time_until_token();
+
+    void consume();
+
+  private:
+    void refill();
+
+    double m_rate;
+    double m_burst;
+
+    double m_tokens;
+    Clock::time_point m_last_refill;
+};
@@ -0,0 +1,111 @@
+#include "heartbeat.h"
+
+#include <cstring>
+
+Heartbeat::Slot Heartbeat::s_slots[Heartbeat::max_threads];
+thread_local Heartbeat* Heartbeat::s_current = nullptr;
+
+Heartbeat::Heartbeat(const std::string& name)
+    : m_slot(nullptr), m_prev(s_current) {
+    for (Slot& slot : s_slots) {
+        int expected = FREE;
+        if (!slot.m_state.compare_exchange_strong(expected, CLAIMING)) {
+            continue;
+        }
+
+        std::strncpy(slot.m_name, name.c_str(), sizeof(slot.m_name) - 1);
+        slot.m_name[sizeof(slot.m_name) - 1] = '\0';
+        slot.m_stage = "start";
+        slot.m_lock = nullptr;
+        slot.m_beat_ns = now_ns();
+        slot.m_idle_until_ns = busy;
+        slot.m_state = ACTIVE;
+
+        m_slot = &slot;
+        break;
+    }
+
+    s_current = this;
+}
+
+Heartbeat::~Heartbeat() {
+    s_current = m_prev;
+
+    if (m_slot) {
+        m_slot->m_state = FREE;
+    }
+}
+
+void Heartbeat::beat(const char* stage, const char* lock) {
+    if (!m_slot) {
+        return;
+    }
+
+    m_slot->m_stage.store(stage, std::memory_order_relaxed);
+    m_slot->m_lock.store(lock, std::memory_order_relaxed);
+    m_slot->m_idle_until_ns.store(busy, std::memory_order_relaxed);
+    m_slot->m_beat_ns.store(now_ns(), std::memory_order_release);
+}
+
+void Heartbeat::beat() {
+    if (!m_slot) {
+        return;
+    }
+
+    m_slot->m_idle_until_ns.store(busy, std::memory_order_relaxed);
+    m_slot->m_beat_ns.store(now_ns(), std::memory_order_release);
+}
+
+void Heartbeat::idle(Clock::time_point deadline) {
+    if (!m_slot) {
+        return;
+    }
+
+    m_slot->m_idle_until_ns.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            deadline.time_since_epoch())
+            .count(),
+        std::memory_order_relaxed);
+    m_slot->m_beat_ns.store(now_ns(), std::memory_order_release);
+}
+
+void Heartbeat::mark(const char* stage, const char* lock) {
+    if (s_current) {
+        s_current->beat(stage, lock);
+    }
+}
+
+std::vector<Heartbeat::Snapshot> Heartbeat::snapshot() {
+    std::vector<Snapshot> snapshots;
+
+    for (size_t i = 0; i < max_threads; i++) {
+        Slot& slot = s_slots[i];
+        if (slot.m_state != ACTIVE) {
+            continue;
+        }
+
+        Snapshot snapshot;
+        snapshot.m_slot = i;
+        snapshot.m_beat = Clock::time_point(std::chrono::nanoseconds(
+            slot.m_beat_ns.load(std::memory_order_acquire)));
+        snapshot.m_stage = slot.m_stage.load(std::memory_order_relaxed);
+        snapshot.m_lock = slot.m_lock.load(std::memory_order_relaxed);
+
+        int64_t idle_until_ns =
+            slot.m_idle_until_ns.load(std::memory_order_relaxed);
+        snapshot.m_idle = idle_until_ns != busy;
+        snapshot.m_idle_until =
+            Clock::time_point(std::chrono::nanoseconds(idle_until_ns));
+        snapshot.m_name = slot.m_name;
+
+        snapshots.push_back(snapshot);
+    }
+
+    return snapshots;
+}
+
+int64_t Heartbeat::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now().time_since_epoch())
+        .count();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Per-thread progress marker read by the watchdog. A thread claims a slot in
+// a shared array and publishes a timestamp with the stage and lock it is in.
+// A waiting thread publishes when it expects to wake instead, so waits of any
+// length need no periodic beats. Stage and lock names must be string
+// literals, beating never allocates.
+class Heartbeat {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t max_threads = 64;
+
+    struct Snapshot {
+        size_t m_slot;
+        std::string m_name;
+        const char* m_stage;
+        const char* m_lock; // null if none
+        Clock::time_point m_beat;
+
+        // set while waiting, time_point::max if the wait has no timeout
+        bool m_idle;
+        Clock::time_point m_idle_until;
+    };
+
+    // the name is truncated to fit the slot
+    Heartbeat(const std::string& name);
+    ~Heartbeat();
+
+    Heartbeat(const Heartbeat&) = delete;
+    Heartbeat& operator=(const Heartbeat&) = delete;
+
+    void beat(const char* stage, const char* lock = nullptr);
+
+    // refreshes the timestamp, keeps the stage
+    void beat();
+
+    // keeps the stage and marks the thread as waiting until the deadline,
+    // time_point::max for no timeout. the next beat ends it
+    void idle(Clock::time_point deadline);
+
+    // sets the stage of the calling thread, a no-op on threads without a
+    // heartbeat. lets shared code such as drivers label what it blocks on
+    static void mark(const char* stage, const char* lock = nullptr);
+
+    // condition_variable::wait_until that publishes the deadline while
+    // waiting, so waiting for work is not mistaken for a stall. takes any
+    // condition variable and lock pair, time_point::max waits untimed
+    template <typename CondVar, typename Lock, typename Predicate>
+    bool wait_until(CondVar& cv, Lock& lock, Clock::time_point deadline,
+                    Predicate pred) {
+        idle(deadline);
+
+        bool ready = true;
+        while (!pred()) {
+            if (deadline == Clock::time_point::max()) {
+                cv.wait(lock);
+            } else if (cv.wait_until(lock, deadline) ==
+                       std::cv_status::timeout) {
+                ready = pred();
+                break;
+            }
+        }
+
+        beat();
+        return ready;
+    }
+
+    template <typename CondVar, typename Lock, typename Predicate>
+    bool wait_for(CondVar& cv, Lock& lock, Clock::duration duration,
+                  Predicate pred) {
+        return wait_until(cv, lock, Clock::now() + duration, pred);
+    }
+
+    template <typename CondVar, typename Lock, typename Predicate>
+    void wait(CondVar& cv, Lock& lock, Predicate pred) {
+        wait_until(cv, lock, Clock::time_point::max(), pred);
+    }
+
+    // every claimed slot, read by the monitor thread
+    static std::vector<Snapshot> snapshot();
+
+  private:
+    enum SlotState : int { FREE, CLAIMING, ACTIVE };
+
+    // one cache line per thread, beats never contend
+    struct alignas(64) Slot {
+        std::atomic<int> m_state;
+        std::atomic<int64_t> m_beat_ns;
+        std::atomic<int64_t> m_idle_until_ns; // busy if not idle
+        std::atomic<const char*> m_stage;
+        std::atomic<const char*> m_lock;
+        char m_name[32];
+    };
+
+    static constexpr int64_t busy = std::numeric_limits<int64_t>::min();
+
+    static int64_t now_ns();
+
+    static Slot s_slots[max_threads];
+    static thread_local Heartbeat* s_current;
+
+    Slot* m_slot; // null if every slot is taken
+    Heartbeat* m_prev;
+};
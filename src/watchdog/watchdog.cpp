@@ -0,0 +1,193 @@
+#include "watchdog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool Watchdog::start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_running) {
+        m_logger.error("start(): Already running!");
+        return false;
+    }
+
+    if (!m_params.m_device_path.empty()) {
+        // opening /dev/watchdog arms it, from here on it must be fed. not
+        // created, a missing device must not turn into a regular file
+        m_fd = open(m_params.m_device_path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (m_fd < 0) {
+            m_logger.error("start(): Failed to open \"" +
+                           m_params.m_device_path +
+                           "\": " + std::strerror(errno));
+            return false;
+        }
+
+        struct stat st;
+        m_regular_file = fstat(m_fd, &st) == 0 && S_ISREG(st.st_mode);
+        if (m_regular_file) {
+            m_logger.warn("\"" + m_params.m_device_path +
+                          "\" is a regular file, kicks reach no hardware");
+        }
+    }
+
+    m_running = true;
+    m_thread = std::thread(&Watchdog::loop, this);
+
+    m_logger.log("Started (stall threshold " +
+                 std::to_string(m_params.m_stall_ms) + " ms)");
+    return true;
+}
+
+void Watchdog::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+
+        m_running = false;
+        m_cv.notify_all();
+    }
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    if (m_fd >= 0) {
+        // magic close, disarms the device on a clean exit
+        if (::write(m_fd, "V", 1) != 1) {
+            m_logger.warn("shutdown(): Failed to disarm watchdog device");
+        }
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    m_logger.log("Stopped, stalls: " + std::to_string(m_stalls) +
+                 ", longest: " + std::to_string(m_longest_stall_ms) + " ms");
+}
+
+void Watchdog::loop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_running) {
+        m_cv.wait_for(lock, std::chrono::milliseconds(m_params.m_check_ms),
+                      [&]() { return !m_running; });
+        if (!m_running) {
+            return;
+        }
+
+        lock.unlock();
+        check();
+        lock.lock();
+    }
+}
+
+void Watchdog::check() {
+    Heartbeat::Clock::time_point now = Heartbeat::Clock::now();
+    std::vector<Heartbeat::Snapshot> snapshots = Heartbeat::snapshot();
+
+    auto age_ms = [&](Heartbeat::Clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now - t)
+            .count();
+    };
+
+    // a waiting thread is late once it overruns its own deadline, one
+    // waiting without a timeout never is
+    auto since = [](const Heartbeat::Snapshot& snapshot) {
+        return snapshot.m_idle ? snapshot.m_idle_until : snapshot.m_beat;
+    };
+    auto overdue = [&](const Heartbeat::Snapshot& snapshot) {
+        if (snapshot.m_idle &&
+            snapshot.m_idle_until == Heartbeat::Clock::time_point::max()) {
+            return false;
+        }
+        return age_ms(since(snapshot)) > m_params.m_stall_ms;
+    };
+
+    bool stalled = false;
+    bool new_stall = false;
+    bool seen[Heartbeat::max_threads] = {};
+
+    for (const Heartbeat::Snapshot& snapshot : snapshots) {
+        size_t i = snapshot.m_slot;
+        seen[i] = true;
+
+        if (!overdue(snapshot)) {
+            if (m_stalled[i]) {
+                int64_t stall_ms = age_ms(m_stall_start[i]);
+                m_longest_stall_ms = std::max(m_longest_stall_ms, stall_ms);
+                m_stalled[i] = false;
+
+                m_logger.warn("\"" + snapshot.m_name + "\" recovered after " +
+                              std::to_string(stall_ms) + " ms");
+            }
+            continue;
+        }
+
+        stalled = true;
+        if (!m_stalled[i]) {
+            m_stalled[i] = true;
+            m_stall_start[i] = since(snapshot);
+            m_stalls++;
+            new_stall = true;
+        }
+    }
+
+    // slots released while stalled, e.g. a thread that exited
+    for (size_t i = 0; i < Heartbeat::max_threads; i++) {
+        if (!seen[i]) {
+            m_stalled[i] = false;
+        }
+    }
+
+    if (new_stall) {
+        std::string dump;
+        for (const Heartbeat::Snapshot& snapshot : snapshots) {
+            dump += "\n\t" + snapshot.m_name + ": " + snapshot.m_stage;
+            if (snapshot.m_lock) {
+                dump += " [" + std::string(snapshot.m_lock) + "]";
+            }
+            dump += ", last beat " + std::to_string(age_ms(snapshot.m_beat)) +
+                    " ms ago";
+            if (snapshot.m_idle) {
+                dump += ", waiting";
+                if (snapshot.m_idle_until !=
+                    Heartbeat::Clock::time_point::max()) {
+                    int64_t late_ms = age_ms(snapshot.m_idle_until);
+                    dump += late_ms >= 0
+                                ? ", deadline " + std::to_string(late_ms) +
+                                      " ms ago"
+                                : ", deadline in " +
+                                      std::to_string(-late_ms) + " ms";
+                }
+            }
+            if (m_stalled[snapshot.m_slot]) {
+                dump += " (STALLED)";
+            }
+        }
+
+        m_logger.error("Stall detected, thread stages:" + dump);
+    }
+
+    // a stalled board is left for the hardware watchdog to reset
+    if (!stalled) {
+        kick();
+    }
+}
+
+void Watchdog::kick() {
+    if (m_fd < 0) {
+        return;
+    }
+
+    // a stand-in file is rewritten in place instead of growing
+    ssize_t res = m_regular_file ? pwrite(m_fd, "k", 1, 0)
+                                 : ::write(m_fd, "k", 1);
+    if (res != 1) {
+        m_logger.warn("kick(): Write failed: " +
+                      std::string(std::strerror(errno)));
+    }
+}
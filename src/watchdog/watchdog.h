@@ -0,0 +1,56 @@
+#pragma once
+
+#include "heartbeat.h"
+
+#include <homecontroller/util/logger.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Watches the heartbeats of all instrumented threads. A thread that has not
+// beaten for longer than the stall threshold, or a waiting thread that
+// overran its deadline by as much, is reported along with the stage and lock
+// of every thread. Optionally keeps a hardware watchdog device fed
+// while no thread is stalled.
+class Watchdog {
+  public:
+    struct Params {
+        int m_stall_ms;
+        int m_check_ms;
+        std::string m_device_path; // empty to not kick a device
+    };
+
+    Watchdog(const Params& params)
+        : m_logger("Watchdog"), m_params(params), m_running(false), m_fd(-1),
+          m_regular_file(false), m_stalls(0), m_longest_stall_ms(0) {}
+    ~Watchdog() { shutdown(); }
+
+    bool start();
+    void shutdown();
+
+  private:
+    void loop();
+    void check();
+    void kick();
+
+    hc::util::Logger m_logger;
+    Params m_params;
+
+    bool m_running;
+    std::thread m_thread;
+
+    // /dev/watchdog or an existing stand-in file
+    int m_fd;
+    bool m_regular_file;
+
+    // only touched by the monitor thread
+    bool m_stalled[Heartbeat::max_threads] = {};
+    Heartbeat::Clock::time_point m_stall_start[Heartbeat::max_threads];
+    uint64_t m_stalls;
+    int64_t m_longest_stall_ms;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
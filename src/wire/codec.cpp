@@ -0,0 +1,153 @@
+#include "codec.h"
+
+#include <map>
+
+namespace wire {
+
+namespace {
+
+std::string encode_frame(Opcode opcode, const void* payload, size_t len) {
+    FrameHeader header = {};
+    header.m_version = version;
+    header.m_opcode = opcode;
+    header.m_payload_len = static_cast<uint16_t>(len);
+
+    std::string frame(sizeof(header) + len, '\0');
+    std::memcpy(&frame[0], &header, sizeof(header));
+    if (len > 0) {
+        std::memcpy(&frame[sizeof(header)], payload, len);
+    }
+
+    return frame;
+}
+
+} // namespace
+
+Result<Encoding> str_to_encoding(const std::string& str) {
+    static std::map<std::string, Encoding> str_to_encoding_map = {
+        {"json", Encoding::JSON}, {"binary", Encoding::BINARY}};
+
+    auto mit = str_to_encoding_map.find(str);
+    if (mit == str_to_encoding_map.end()) {
+        return Result<Encoding>::Err(Error(__func__, "invalid encoding"));
+    }
+
+    return Result<Encoding>::Ok(mit->second);
+}
+
+Result<Frame> parse_frame(const char* data, size_t len) {
+    if (len < sizeof(FrameHeader)) {
+        return Result<Frame>::Err(Error(__func__, "truncated frame header"));
+    }
+
+    FrameHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.m_version != version) {
+        return Result<Frame>::Err(
+            Error(__func__, "unsupported frame version " +
+                                std::to_string(header.m_version)));
+    }
+
+    if (sizeof(header) + header.m_payload_len > len) {
+        return Result<Frame>::Err(Error(__func__, "truncated frame payload"));
+    }
+
+    Frame frame;
+    frame.m_opcode = header.m_opcode;
+    frame.m_payload = data + sizeof(header);
+    frame.m_payload_len = header.m_payload_len;
+
+    return Result<Frame>::Ok(frame);
+}
+
+std::string encode_command(Opcode opcode) {
+    return encode_frame(opcode, nullptr, 0);
+}
+
+std::string encode_set_encoding(Encoding encoding) {
+    EncodingPayload payload = {};
+    payload.m_encoding = encoding;
+
+    return encode_frame(Opcode::SET_ENCODING, &payload, sizeof(payload));
+}
+
+std::string encode_state(const hc::api::plug::State& state,
+                         const PowerMeter::Stats* power) {
+    struct {
+        StatePayload m_state;
+        PowerPayload m_power;
+    } payload = {};
+
+    payload.m_state.m_power_state = static_cast<uint8_t>(state.m_power_state);
+    payload.m_state.m_lock_duration = state.m_lock_duration;
+
+    size_t len = sizeof(StatePayload);
+    if (power) {
+        payload.m_state.m_flags |= state_flag_power;
+        payload.m_power.m_min_w = static_cast<float>(power->m_min_w);
+        payload.m_power.m_mean_w = static_cast<float>(power->m_mean_w);
+        payload.m_power.m_max_w = static_cast<float>(power->m_max_w);
+        payload.m_power.m_energy_kwh = power->m_energy_kwh;
+        len += sizeof(PowerPayload);
+    }
+
+    return encode_frame(Opcode::STATE, &payload, len);
+}
+
+bool decode_state(const Frame& frame, hc::api::plug::State& state,
+                  std::optional<PowerMeter::Stats>& power) {
+    StatePayload state_payload;
+    if (frame.m_opcode != Opcode::STATE ||
+        !read_payload(frame, 0, state_payload)) {
+        return false;
+    }
+
+    state.m_power_state = static_cast<hc::api::plug::State::PowerState>(
+        state_payload.m_power_state);
+    state.m_lock_duration = state_payload.m_lock_duration;
+
+    power.reset();
+    if (state_payload.m_flags & state_flag_power) {
+        PowerPayload power_payload;
+        if (!read_payload(frame, sizeof(StatePayload), power_payload)) {
+            return false;
+        }
+
+        PowerMeter::Stats stats = {};
+        stats.m_min_w = power_payload.m_min_w;
+        stats.m_mean_w = power_payload.m_mean_w;
+        stats.m_max_w = power_payload.m_max_w;
+        stats.m_energy_kwh = power_payload.m_energy_kwh;
+        power = stats;
+    }
+
+    return true;
+}
+
+::sio::message::ptr state_to_message(const hc::api::plug::State& state,
+                                     const PowerMeter::Stats* power) {
+    ::sio::message::ptr state_msg = ::sio::object_message::create();
+    state_msg->get_map()["powerState"] = ::sio::string_message::create(
+        hc::api::plug::power_state_to_string(state.m_power_state));
+    state_msg->get_map()["lockDuration"] =
+        ::sio::int_message::create(state.m_lock_duration);
+
+    if (power) {
+        ::sio::message::ptr power_msg = ::sio::object_message::create();
+        power_msg->get_map()["minW"] =
+            ::sio::double_message::create(power->m_min_w);
+        power_msg->get_map()["meanW"] =
+            ::sio::double_message::create(power->m_mean_w);
+        power_msg->get_map()["maxW"] =
+            ::sio::double_message::create(power->m_max_w);
+        power_msg->get_map()["energyKwh"] =
+            ::sio::double_message::create(power->m_energy_kwh);
+
+        state_msg->get_map()["power"] = power_msg;
+    }
+
+    return state_msg;
+}
+
+} // namespace wire
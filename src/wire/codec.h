@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../telemetry/power_meter.h"
+#include "format.h"
+
+#include <homecontroller/api/device_data/plug.h>
+#include <homecontroller/util/result.h>
+
+#include <sio_client.h>
+
+#include <cstring>
+#include <optional>
+#include <string>
+
+// Encodes and decodes both wire encodings. The binary decoder validates a
+// frame in place and reads payloads straight out of the received buffer.
+namespace wire {
+
+// points into the buffer it was parsed from
+struct Frame {
+    Opcode m_opcode;
+    const char* m_payload;
+    uint16_t m_payload_len;
+};
+
+Result<Encoding> str_to_encoding(const std::string& str);
+
+Result<Frame> parse_frame(const char* data, size_t len);
+
+// false if the payload is too short
+template <typename T>
+bool read_payload(const Frame& frame, size_t offset, T& out) {
+    if (offset + sizeof(T) > frame.m_payload_len) {
+        return false;
+    }
+
+    std::memcpy(&out, frame.m_payload + offset, sizeof(T));
+    return true;
+}
+
+std::string encode_command(Opcode opcode);
+std::string encode_set_encoding(Encoding encoding);
+std::string encode_state(const hc::api::plug::State& state,
+                         const PowerMeter::Stats* power);
+
+bool decode_state(const Frame& frame, hc::api::plug::State& state,
+                  std::optional<PowerMeter::Stats>& power);
+
+// string-keyed object, the original encoding
+::sio::message::ptr state_to_message(const hc::api::plug::State& state,
+                                     const PowerMeter::Stats* power);
+
+} // namespace wire
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+// Layout of the compact binary encoding, carried as a socket.io binary
+// message. All integers are little-endian.
+//
+//   FrameHeader | payload
+//
+// Commands: POWER_ON and POWER_OFF have no payload, SET_ENCODING carries
+// EncodingPayload. States: STATE carries StatePayload, followed by
+// PowerPayload if state_flag_power is set.
+namespace wire {
+
+constexpr uint8_t version = 1;
+
+enum class Opcode : uint8_t {
+    POWER_ON = 1,
+    POWER_OFF = 2,
+    SET_ENCODING = 3,
+    STATE = 128
+};
+
+enum class Encoding : uint8_t { JSON = 0, BINARY = 1 };
+
+constexpr uint8_t state_flag_power = 1;
+
+struct FrameHeader {
+    uint8_t m_version;
+    Opcode m_opcode;
+    uint16_t m_payload_len;
+};
+
+struct EncodingPayload {
+    Encoding m_encoding;
+    uint8_t m_reserved[3];
+};
+
+struct StatePayload {
+    uint8_t m_power_state;
+    uint8_t m_flags;
+    uint16_t m_reserved;
+    int32_t m_lock_duration;
+};
+
+struct PowerPayload {
+    float m_min_w;
+    float m_mean_w;
+    float m_max_w;
+    uint32_t m_reserved;
+    double m_energy_kwh;
+};
+
+static_assert(sizeof(FrameHeader) == 4, "unexpected FrameHeader layout");
+static_assert(sizeof(EncodingPayload) == 4,
+              "unexpected EncodingPayload layout");
+static_assert(sizeof(StatePayload) == 8, "unexpected StatePayload layout");
+static_assert(sizeof(PowerPayload) == 24, "unexpected PowerPayload layout");
+
+// payloads are copied as host structs
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "the binary encoding is little-endian");
+
+} // namespace wire